@@ -2,6 +2,7 @@
 #include "tcp_config.hh"
 #include "tcp_minnow_socket.hh"
 #include "tun.hh"
+#include "tuntap_adapter.hh"
 
 #include <cstdint>
 #include <cstdlib>
@@ -35,7 +36,11 @@ void show_usage( const char* argv0, const char* msg )
 
        << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
-       << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
+       << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n"
+       << "   -g              Exchange GSO/GRO super-packets with the tun     (off)\n"
+       << "   -G <size>       Cut super-packets into <size>-byte segments     " << TCPConfig::MAX_PAYLOAD_SIZE
+       << "\n"
+       << "   -m              Discover the path MTU by probing (RFC 4821)     (off)\n\n"
 
        << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
        << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
@@ -56,7 +61,7 @@ void check_argc( const span<char*>& args, size_t curr, const char* err )
   }
 }
 
-tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char*>& args )
+tuple<TCPConfig, FdAdapterConfig, bool, const char*, bool> get_config( const span<char*>& args )
 {
   TCPConfig c_fsm {};
   c_fsm.isn = Wrap32 { random_device()() };
@@ -66,6 +71,7 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
 
   size_t curr = 1;
   bool listen = false;
+  bool gso = false;
   const size_t argc = args.size();
 
   string source_address = LOCAL_ADDRESS_DFLT;
@@ -101,6 +107,20 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
       tundev = args[curr + 1];
       curr += 2;
 
+    } else if ( strncmp( "-g", args[curr], 3 ) == 0 ) {
+      gso = true;
+      c_fsm.max_payload_size = TCPOverIPv4OverTunFdAdapter::MAX_GSO_PAYLOAD_SIZE;
+      curr += 1;
+
+    } else if ( strncmp( "-G", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -G requires one argument." );
+      c_filt.segment_size = strtoul( args[curr + 1], nullptr, 0 );
+      curr += 2;
+
+    } else if ( strncmp( "-m", args[curr], 3 ) == 0 ) {
+      c_fsm.plpmtud = true;
+      curr += 1;
+
     } else if ( strncmp( "-Lu", args[curr], 3 ) == 0 ) {
       check_argc( args, curr, "ERROR: -Lu requires one argument." );
       const float lossrate = strtof( args[curr + 1], nullptr );
@@ -139,7 +159,7 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
     c_filt.source = { source_address, source_port };
   }
 
-  return make_tuple( c_fsm, c_filt, listen, tundev );
+  return make_tuple( c_fsm, c_filt, listen, tundev, gso );
 }
 } // namespace
 
@@ -157,9 +177,9 @@ int main( int argc, char** argv )
       return EXIT_FAILURE;
     }
 
-    auto [c_fsm, c_filt, listen, tun_dev_name] = get_config( args );
+    auto [c_fsm, c_filt, listen, tun_dev_name, gso] = get_config( args );
     LossyTCPOverIPv4MinnowSocket tcp_socket( LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>(
-      TCPOverIPv4OverTunFdAdapter( TunFD( tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name ) ) ) );
+      TCPOverIPv4OverTunFdAdapter( TunFD( tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name, gso ) ) ) );
 
     if ( listen ) {
       tcp_socket.listen_and_accept( c_fsm, c_filt );
@@ -169,6 +189,12 @@ int main( int argc, char** argv )
 
     bidirectional_stream_copy( tcp_socket, tcp_socket.peer_address().to_string() );
     tcp_socket.wait_until_closed();
+
+    const TCPStats stats = tcp_socket.stats();
+    cerr << "DEBUG: minnow sent " << stats.sender.bytes_sent << " bytes in " << stats.sender.segments_sent
+         << " segments (" << stats.sender.retransmissions << " retransmitted), received " << stats.bytes_received
+         << " bytes; srtt " << stats.sender.srtt_us / 1000 << " ms, " << stats.sender.window_limited_ms
+         << " ms window-limited.\n";
   } catch ( const exception& e ) {
     cerr << "Exception: " << e.what() << "\n";
     return EXIT_FAILURE;
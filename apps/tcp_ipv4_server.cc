@@ -0,0 +1,169 @@
+#include "address.hh"
+#include "exception.hh"
+#include "helpers.hh"
+#include "tcp_config.hh"
+#include "tcp_listener.hh"
+#include "tun.hh"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr const char* TUN_DFLT = "tun144";
+
+namespace {
+void show_usage( const char* argv0, const char* msg )
+{
+  cout << "Usage: " << argv0 << " [options] <address> <port>\n\n"
+       << "   An echo server for many connections at once, with one TCPListener over a TUN device.\n"
+       << "   <address>:<port> is the address to listen on (address 0 for any).\n\n"
+
+       << "   Option                                                          Default\n"
+       << "   --                                                              --\n\n"
+
+       << "   -b <backlog>    Allow <backlog> connections in each queue       " << TCPListener::DEFAULT_BACKLOG
+       << "\n"
+       << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
+
+       << "   -h              Show this message.\n\n";
+
+  if ( msg != nullptr ) {
+    cout << msg;
+  }
+  cout << "\n";
+}
+
+// Echo whatever a connection has received back to it, and close it once the peer has
+void echo( TCPPeer& peer )
+{
+  Reader& inbound = peer.inbound_reader();
+  Writer& outbound = peer.outbound_writer();
+  while ( inbound.bytes_buffered() > 0 and outbound.available_capacity() > 0 ) {
+    const string_view data = inbound.peek().substr( 0, outbound.available_capacity() );
+    outbound.push( string { data } );
+    inbound.pop( data.size() );
+  }
+  if ( inbound.is_finished() and not outbound.is_closed() ) {
+    outbound.close();
+  }
+}
+
+string describe( const TCPListener::Connection& conn )
+{
+  return Address::from_ipv4_numeric( conn.remote_ip() ).ip() + ":" + to_string( conn.remote_port() );
+}
+
+void serve( TunFD& tun, TCPListener& listener )
+{
+  const auto transmit = [&]( const InternetDatagram& dgram ) { tun.write( serialize( dgram ) ); };
+
+  vector<shared_ptr<TCPListener::Connection>> connections;
+  auto last_tick = steady_clock::now();
+
+  while ( true ) {
+    // wait (for at most 1 ms) for a datagram
+    pollfd tun_poll { .fd = tun.fd_num(), .events = POLLIN, .revents = 0 };
+    if ( ::poll( &tun_poll, 1, 1 ) < 0 ) {
+      throw unix_error { "poll" };
+    }
+    if ( tun_poll.revents & POLLIN ) { // NOLINT(*-bitwise)
+      string buffer;
+      tun.read( buffer );
+      InternetDatagram dgram;
+      if ( parse( dgram, array { move( buffer ) } ) ) {
+        listener.receive( move( dgram ), transmit );
+      }
+    }
+
+    while ( auto conn = listener.accept() ) {
+      cerr << "DEBUG: accepted a connection from " << describe( *conn ) << "\n";
+      connections.push_back( move( conn ) );
+    }
+
+    for ( const auto& conn : connections ) {
+      echo( conn->peer() );
+    }
+    erase_if( connections, []( const auto& conn ) {
+      if ( conn->peer().active() ) {
+        return false;
+      }
+      cerr << "DEBUG: connection from " << describe( *conn ) << " is closed\n";
+      return true;
+    } );
+
+    listener.push( transmit );
+
+    const auto now = steady_clock::now();
+    const uint64_t ms = duration_cast<milliseconds>( now - last_tick ).count();
+    if ( ms > 0 ) {
+      listener.tick( ms, transmit );
+      last_tick += milliseconds { ms };
+    }
+  }
+}
+} // namespace
+
+int main( int argc, char** argv )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+
+    auto args = span( argv, argc );
+    const char* tundev = TUN_DFLT;
+    size_t backlog = TCPListener::DEFAULT_BACKLOG;
+
+    size_t curr = 1;
+    while ( args.size() - curr > 2 ) {
+      if ( strncmp( "-b", args[curr], 3 ) == 0 ) {
+        backlog = strtoul( args[curr + 1], nullptr, 0 );
+        curr += 2;
+      } else if ( strncmp( "-d", args[curr], 3 ) == 0 ) {
+        tundev = args[curr + 1];
+        curr += 2;
+      } else if ( strncmp( "-h", args[curr], 3 ) == 0 ) {
+        show_usage( args[0], nullptr );
+        return EXIT_SUCCESS;
+      } else {
+        show_usage( args[0], string( "ERROR: unrecognized option " + string( args[curr] ) ).c_str() );
+        return EXIT_FAILURE;
+      }
+    }
+
+    if ( args.size() - curr != 2 ) {
+      show_usage( args.front(), "ERROR: required arguments are missing." );
+      return EXIT_FAILURE;
+    }
+
+    const Address local { args[curr], args[curr + 1] };
+    if ( local.port() == 0 ) {
+      show_usage( args[0], "ERROR: listen port cannot be zero." );
+      return EXIT_FAILURE;
+    }
+
+    TCPConfig cfg {};
+    cfg.isn = Wrap32 { random_device()() };
+
+    TunFD tun { tundev };
+    TCPListener listener { cfg, local.ipv4_numeric(), local.port(), backlog };
+    serve( tun, listener );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
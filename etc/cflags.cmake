@@ -6,3 +6,9 @@ set(SANITIZING_FLAGS -fno-sanitize-recover=all -fsanitize=undefined -fsanitize=a
 # ask for more warnings from the compiler
 set (CMAKE_BASE_CXX_FLAGS "${CMAKE_CXX_FLAGS}")
 set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -Wall -Wpedantic -Wextra -Weffc++ -Werror -Wshadow -Wpointer-arith -Wcast-qual -Wformat=2 -Wno-unqualified-std-cast-call -Wno-non-virtual-dtor")
+
+# optionally forbid implicit (deep) copies of Ref<T>, so that every copy of a payload has to be an explicit clone()
+option(DISALLOW_REF_IMPLICIT_COPY "Forbid implicit copies of Ref<T>" OFF)
+if (DISALLOW_REF_IMPLICIT_COPY)
+  add_compile_definitions(DISALLOW_REF_IMPLICIT_COPY)
+endif ()
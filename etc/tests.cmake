@@ -53,10 +53,15 @@ ttest(send_ack)
 ttest(send_close)
 ttest(send_retx)
 ttest(send_extra)
+ttest(send_plpmtud)
+ttest(send_stats)
 
 ttest(net_interface)
 
 ttest(router)
+ttest(router_parallel)
+ttest(link_emulator)
+ttest(tcp_listener)
 
 ttest(no_skip)
 
@@ -94,3 +99,10 @@ set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
 stest(reassembler_speed_test)
+stest(tcp_listener_speed_test)
+stest(header_speed_test)
+stest(checksum_speed_test)
+stest(router_speed_test)
+stest(prefix_table_speed_test)
+stest(fragment_speed_test)
+stest(tcp_transfer_speed_test)
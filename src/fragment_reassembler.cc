@@ -0,0 +1,171 @@
+#include "fragment_reassembler.hh"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+optional<InternetDatagram> FragmentReassembler::insert( InternetDatagram&& fragment, const uint64_t now_ms )
+{
+  if ( not is_fragment( fragment.header ) ) {
+    return move( fragment );
+  }
+
+  const IPv4Header& header = fragment.header;
+  string data;
+  if ( fragment.payload.size() == 1 and fragment.payload.front().is_owned() ) {
+    data = fragment.payload.front().release();
+  } else {
+    for ( const auto& buf : fragment.payload ) {
+      data.append( buf.get() );
+    }
+  }
+
+  // every fragment but the last carries a multiple of 8 bytes, and no datagram is longer than 65535 bytes
+  const size_t begin = static_cast<size_t>( header.offset ) * 8;
+  const size_t end = begin + data.size();
+  if ( ( header.mf and ( data.empty() or data.size() % 8 != 0 ) ) or IPv4Header::LENGTH + end > 65535
+       or data.size() > limits_.max_bytes ) {
+    ++stats_.malformed;
+    return {};
+  }
+
+  skip_stale_arrivals();
+  while ( bytes_ + data.size() > limits_.max_bytes and evict_oldest() ) {}
+
+  const Key key { header.src, header.dst, header.id, header.proto };
+  auto it = datagrams_.find( key );
+  if ( it == datagrams_.end() ) {
+    while ( datagrams_.size() >= limits_.max_datagrams and evict_oldest() ) {}
+    it = datagrams_.emplace( key, Datagram {} ).first;
+    it->second.serial = next_serial_++;
+    arrivals_.push_back( { now_ms + limits_.timeout_ms, key, it->second.serial } );
+  }
+  Datagram& datagram = it->second;
+
+  // the last fragment says how long the datagram is, and nothing may go past that
+  if ( not header.mf ) {
+    const bool longer = not datagram.pieces.empty()
+                        and datagram.pieces.back().begin + datagram.pieces.back().data.size() > end;
+    if ( longer or ( datagram.length.has_value() and *datagram.length != end ) ) {
+      ++stats_.malformed;
+      drop( it );
+      return {};
+    }
+    datagram.length = end;
+  } else if ( datagram.length.has_value() and end > *datagram.length ) {
+    ++stats_.malformed;
+    drop( it );
+    return {};
+  }
+
+  if ( header.offset == 0 and not datagram.first_header.has_value() ) {
+    datagram.first_header = header;
+  }
+
+  add_bytes( datagram, begin, move( data ) );
+
+  if ( not datagram.length.has_value() or datagram.received != *datagram.length
+       or not datagram.first_header.has_value() ) {
+    return {};
+  }
+
+  // complete: the pieces (in order, and without gaps) become the payload
+  InternetDatagram whole;
+  whole.header = *datagram.first_header;
+  whole.header.hlen = IPv4Header::LENGTH / 4; // (options weren't kept)
+  whole.header.mf = false;
+  whole.header.offset = 0;
+  whole.header.len = static_cast<uint16_t>( IPv4Header::LENGTH + *datagram.length );
+  whole.header.compute_checksum();
+  whole.payload.reserve( datagram.pieces.size() );
+  for ( auto& piece : datagram.pieces ) {
+    whole.payload.emplace_back( move( piece.data ) );
+  }
+
+  bytes_ -= datagram.received;
+  datagrams_.erase( it );
+  ++stats_.reassembled;
+  return whole;
+}
+
+void FragmentReassembler::add_bytes( Datagram& datagram, const size_t begin, string&& data )
+{
+  auto& pieces = datagram.pieces;
+  const size_t end = begin + data.size();
+  const auto piece_end = []( const Piece& piece ) { return piece.begin + piece.data.size(); };
+  const auto first = partition_point(
+    pieces.begin(), pieces.end(), [&]( const Piece& piece ) { return piece_end( piece ) <= begin; } );
+
+  // usually, nothing overlaps, and the data goes in as it is
+  if ( first == pieces.end() or first->begin >= end ) {
+    datagram.received += data.size();
+    bytes_ += data.size();
+    pieces.insert( first, { begin, move( data ) } );
+    return;
+  }
+
+  // otherwise, only the gaps between the pieces already there are filled in
+  vector<Piece> gaps;
+  size_t cursor = begin;
+  for ( auto piece = first; piece != pieces.end() and piece->begin < end; ++piece ) {
+    if ( piece->begin > cursor ) {
+      gaps.push_back( { cursor, data.substr( cursor - begin, piece->begin - cursor ) } );
+    }
+    cursor = max( cursor, piece_end( *piece ) );
+  }
+  if ( cursor < end ) {
+    gaps.push_back( { cursor, data.substr( cursor - begin ) } );
+  }
+
+  for ( auto& gap : gaps ) {
+    datagram.received += gap.data.size();
+    bytes_ += gap.data.size();
+    const auto position = partition_point(
+      pieces.begin(), pieces.end(), [&]( const Piece& piece ) { return piece.begin < gap.begin; } );
+    pieces.insert( position, move( gap ) );
+  }
+}
+
+void FragmentReassembler::expire( const uint64_t now_ms )
+{
+  while ( not arrivals_.empty() and arrivals_.front().deadline <= now_ms ) {
+    const Arrival arrival = arrivals_.front();
+    arrivals_.pop_front();
+    const auto it = datagrams_.find( arrival.key );
+    if ( it != datagrams_.end() and it->second.serial == arrival.serial ) {
+      ++stats_.timed_out;
+      drop( it );
+    }
+  }
+}
+
+bool FragmentReassembler::evict_oldest()
+{
+  skip_stale_arrivals();
+  if ( arrivals_.empty() ) {
+    return false;
+  }
+
+  drop( datagrams_.find( arrivals_.front().key ) );
+  arrivals_.pop_front();
+  ++stats_.evicted;
+  return true;
+}
+
+void FragmentReassembler::skip_stale_arrivals()
+{
+  while ( not arrivals_.empty() ) {
+    const auto it = datagrams_.find( arrivals_.front().key );
+    if ( it != datagrams_.end() and it->second.serial == arrivals_.front().serial ) {
+      return;
+    }
+    arrivals_.pop_front();
+  }
+}
+
+void FragmentReassembler::drop( const unordered_map<Key, Datagram, KeyHash>::iterator it )
+{
+  bytes_ -= it->second.received;
+  datagrams_.erase( it );
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "ipv4_datagram.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// \brief Puts fragmented IPv4 datagrams back together (RFC 791 section 3.2, RFC 815).
+//
+// Fragments are grouped by (source, destination, identification, protocol). Like the stream Reassembler, each
+// group keeps the byte ranges it has received as a sorted list of non-overlapping pieces: an arriving fragment
+// only contributes the bytes that aren't there yet, so duplicates and overlaps cost nothing, and the datagram is
+// complete once the bytes received add up to its length (which the last fragment gives away). The pieces then
+// become the reassembled datagram's payload buffers, without being copied again.
+//
+// A datagram whose fragments haven't all arrived within `timeout_ms` is dropped, and so are the oldest
+// incomplete datagrams whenever the buffered bytes or the number of incomplete datagrams would exceed its
+// limits.
+class FragmentReassembler
+{
+public:
+  struct Limits
+  {
+    size_t max_bytes { 4 * 1024 * 1024 }; // payload bytes buffered, over all incomplete datagrams
+    size_t max_datagrams { 1024 };        // incomplete datagrams
+    uint64_t timeout_ms { 30000 };        // time from a datagram's first fragment until it is given up on
+  };
+
+  struct Stats
+  {
+    uint64_t reassembled {}; // datagrams completed
+    uint64_t timed_out {};   // incomplete datagrams dropped because they took too long
+    uint64_t evicted {};     // incomplete datagrams dropped to stay within the limits
+    uint64_t malformed {};   // fragments (or datagrams) dropped because they didn't fit together
+  };
+
+  FragmentReassembler() : FragmentReassembler( Limits {} ) {}
+  explicit FragmentReassembler( const Limits& limits ) : limits_( limits ) {}
+
+  // Whether a datagram is a fragment (rather than a whole datagram)
+  static bool is_fragment( const IPv4Header& header ) { return header.mf or header.offset != 0; }
+
+  // Take a fragment that arrived at time `now_ms`, and return the datagram if it is now complete. (A datagram
+  // that isn't a fragment is returned as it is.)
+  std::optional<InternetDatagram> insert( InternetDatagram&& fragment, uint64_t now_ms );
+
+  // Drop the incomplete datagrams whose time is up
+  void expire( uint64_t now_ms );
+
+  // Accessors
+  size_t size() const { return datagrams_.size(); } // incomplete datagrams
+  size_t bytes() const { return bytes_; }           // payload bytes buffered
+  const Stats& stats() const { return stats_; }
+
+private:
+  struct Key
+  {
+    uint32_t src;
+    uint32_t dst;
+    uint16_t id;
+    uint8_t proto;
+    bool operator==( const Key& other ) const = default;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()( const Key& key ) const
+    {
+      const uint64_t high = ( static_cast<uint64_t>( key.src ) << 32 ) | key.dst;
+      const uint64_t low = ( static_cast<uint64_t>( key.id ) << 8 ) | key.proto;
+      return static_cast<size_t>( ( high ^ ( low * 0x9e37'79b9'7f4a'7c15ULL ) ) * 0xbf58'476d'1ce4'e5b9ULL );
+    }
+  };
+
+  struct Piece
+  {
+    size_t begin;
+    std::string data;
+  };
+
+  struct Datagram
+  {
+    std::optional<IPv4Header> first_header {}; // from the fragment at offset 0
+    std::optional<size_t> length {};           // of the payload, once the last fragment has arrived
+    std::vector<Piece> pieces {};              // sorted by `begin`, not overlapping
+    size_t received {};                        // bytes in `pieces`
+    uint64_t serial {};                        // distinguishes it from an earlier datagram with the same key
+  };
+
+  // Add the parts of [begin, begin + data.size()) that `datagram` doesn't have yet
+  void add_bytes( Datagram& datagram, size_t begin, std::string&& data );
+
+  // Drop a datagram (and account for its bytes)
+  void drop( std::unordered_map<Key, Datagram, KeyHash>::iterator it );
+
+  // Drop the oldest incomplete datagram, if there is one (and return whether there was)
+  bool evict_oldest();
+
+  // Forget arrivals of datagrams that are already gone, from the front of `arrivals_`
+  void skip_stale_arrivals();
+
+  Limits limits_;
+  std::unordered_map<Key, Datagram, KeyHash> datagrams_ {};
+  size_t bytes_ {};
+  uint64_t next_serial_ {};
+  Stats stats_ {};
+
+  // Incomplete datagrams in the order their first fragments arrived (with the serials they had, so entries for
+  // datagrams that are already gone can be recognized and skipped)
+  struct Arrival
+  {
+    uint64_t deadline;
+    Key key;
+    uint64_t serial;
+  };
+  std::deque<Arrival> arrivals_ {};
+};
@@ -0,0 +1,153 @@
+#include "neighbor_table.hh"
+
+#include <bit>
+#include <utility>
+
+using namespace std;
+
+// The neighbor's preferred slot (multiplicative hashing, so that consecutive addresses spread out)
+size_t NeighborTable::home( const uint32_t ip ) const
+{
+  const auto bits = static_cast<unsigned>( countr_zero( slots_.size() ) );
+  return static_cast<uint32_t>( ip * 0x9e37'79b1U ) >> ( 32 - bits );
+}
+
+NeighborTable::Neighbor* NeighborTable::find( const uint32_t ip )
+{
+  const size_t mask = slots_.size() - 1;
+  for ( size_t i = home( ip ); slots_[i].occupied; i = ( i + 1 ) & mask ) {
+    if ( slots_[i].ip == ip ) {
+      return &slots_[i];
+    }
+  }
+  return nullptr;
+}
+
+NeighborTable::Neighbor& NeighborTable::find_or_insert( const uint32_t ip )
+{
+  if ( Neighbor* existing = find( ip ) ) {
+    return *existing;
+  }
+
+  // keep the table at most half full, so probe sequences stay short
+  if ( ( size_ + 1 ) * 2 > slots_.size() ) {
+    grow();
+  }
+
+  const size_t mask = slots_.size() - 1;
+  size_t i = home( ip );
+  while ( slots_[i].occupied ) {
+    i = ( i + 1 ) & mask;
+  }
+
+  slots_[i] = Neighbor {};
+  slots_[i].ip = ip;
+  slots_[i].occupied = true;
+  ++size_;
+  return slots_[i];
+}
+
+void NeighborTable::erase( const uint32_t ip )
+{
+  Neighbor* neighbor = find( ip );
+  if ( neighbor == nullptr ) {
+    return;
+  }
+  drop_pending( *neighbor );
+
+  // shift later members of the probe sequence back into the hole, if that doesn't move them before their home
+  const size_t mask = slots_.size() - 1;
+  size_t hole = static_cast<size_t>( neighbor - slots_.data() );
+  for ( size_t i = ( hole + 1 ) & mask; slots_[i].occupied; i = ( i + 1 ) & mask ) {
+    const size_t distance_from_home = ( i - home( slots_[i].ip ) ) & mask;
+    const size_t distance_to_hole = ( i - hole ) & mask;
+    if ( distance_from_home >= distance_to_hole ) {
+      slots_[hole] = slots_[i];
+      hole = i;
+    }
+  }
+
+  slots_[hole] = Neighbor {};
+  --size_;
+}
+
+void NeighborTable::grow()
+{
+  vector<Neighbor> old( slots_.size() * 2 );
+  swap( old, slots_ );
+
+  const size_t mask = slots_.size() - 1;
+  for ( const Neighbor& neighbor : old ) {
+    if ( neighbor.occupied ) {
+      size_t i = home( neighbor.ip );
+      while ( slots_[i].occupied ) {
+        i = ( i + 1 ) & mask;
+      }
+      slots_[i] = neighbor;
+    }
+  }
+}
+
+void NeighborTable::push_pending( Neighbor& neighbor,
+                                  InternetDatagram dgram,
+                                  const uint32_t bytes,
+                                  const uint64_t queued_at )
+{
+  uint32_t node {};
+  if ( free_nodes_.empty() ) {
+    node = static_cast<uint32_t>( pending_.size() );
+    pending_.emplace_back();
+  } else {
+    node = free_nodes_.back();
+    free_nodes_.pop_back();
+  }
+
+  pending_[node].dgram = move( dgram );
+  pending_[node].queued_at = queued_at;
+  pending_[node].bytes = bytes;
+  pending_[node].next = NONE;
+
+  if ( neighbor.pending_tail == NONE ) {
+    neighbor.pending_head = node;
+  } else {
+    pending_[neighbor.pending_tail].next = node;
+  }
+  neighbor.pending_tail = node;
+
+  ++neighbor.pending_datagrams;
+  neighbor.pending_bytes += bytes;
+  ++pending_datagrams_;
+  pending_bytes_ += bytes;
+}
+
+uint32_t NeighborTable::pop_pending( Neighbor& neighbor )
+{
+  const uint32_t node = neighbor.pending_head;
+  if ( node == NONE ) {
+    return 0;
+  }
+
+  neighbor.pending_head = pending_[node].next;
+  if ( neighbor.pending_head == NONE ) {
+    neighbor.pending_tail = NONE;
+  }
+
+  const uint32_t bytes = pending_[node].bytes;
+  --neighbor.pending_datagrams;
+  neighbor.pending_bytes -= bytes;
+  --pending_datagrams_;
+  pending_bytes_ -= bytes;
+  free_node( node );
+  return bytes;
+}
+
+void NeighborTable::drop_pending( Neighbor& neighbor )
+{
+  drain_pending( neighbor, []( const InternetDatagram&, uint64_t ) {} );
+}
+
+void NeighborTable::free_node( const uint32_t node )
+{
+  pending_[node].dgram = {};
+  free_nodes_.push_back( node );
+}
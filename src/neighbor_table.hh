@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ethernet_header.hh"
+#include "ipv4_datagram.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// \brief The ARP cache of a NetworkInterface: everything it knows about each neighbor, keyed by IPv4 address.
+//
+// The table is a single flat array with open addressing (linear probing, and backward-shift deletion so there
+// are no tombstones). Each Neighbor fits in one cache line: its Ethernet address and when that expires, when
+// the interface may next send an ARP request for it, when it was last sent to, and the head and tail of its queue
+// of datagrams waiting for the address. Those datagrams live in a pool of nodes shared by all neighbors, so
+// queueing one doesn't allocate once the pool has grown. The table counts the pending datagrams and their bytes,
+// per neighbor and in total, so the owner can bound them.
+class NeighborTable
+{
+public:
+  static constexpr uint32_t NONE = UINT32_MAX; // "no pending datagram"
+
+  struct alignas( 64 ) Neighbor
+  {
+    uint32_t ip {};
+    bool occupied {};
+    bool resolved {};   // ethernet_address is valid (until expires_at)
+    bool requesting {}; // an ARP request was sent (and another may not be until request_expires_at)
+    EthernetAddress ethernet_address {};
+    uint64_t expires_at {};
+    uint64_t request_expires_at {};
+    uint64_t used_at {}; // when a datagram was last sent to the neighbor
+    uint32_t pending_head { NONE };
+    uint32_t pending_tail { NONE };
+    uint32_t pending_datagrams {};
+    uint32_t pending_bytes {};
+  };
+
+  // The neighbor with this address, or nullptr
+  Neighbor* find( uint32_t ip );
+
+  // The neighbor with this address, added (with nothing known about it) if necessary.
+  // (Invalidates pointers to other neighbors.)
+  Neighbor& find_or_insert( uint32_t ip );
+
+  // Forget a neighbor (dropping its pending datagrams)
+  void erase( uint32_t ip );
+
+  size_t size() const { return size_; }
+
+  // Queue a datagram (of `bytes` bytes) until the neighbor's Ethernet address is known
+  void push_pending( Neighbor& neighbor, InternetDatagram dgram, uint32_t bytes, uint64_t queued_at );
+
+  // Drop the neighbor's oldest pending datagram (if any) and return its size in bytes
+  uint32_t pop_pending( Neighbor& neighbor );
+
+  // Empty the neighbor's queue, then call f( dgram, queued_at ) on each of its datagrams, oldest first.
+  // (The queue is detached and each datagram moved out of its node before f runs, so f may add or remove
+  // neighbors and queue datagrams -- but `neighbor` may be invalid once f has been called.)
+  template<class F>
+  void drain_pending( Neighbor& neighbor, F&& f )
+  {
+    uint32_t node = neighbor.pending_head;
+    neighbor.pending_head = NONE;
+    neighbor.pending_tail = NONE;
+    pending_datagrams_ -= neighbor.pending_datagrams;
+    pending_bytes_ -= neighbor.pending_bytes;
+    neighbor.pending_datagrams = 0;
+    neighbor.pending_bytes = 0;
+
+    while ( node != NONE ) {
+      InternetDatagram dgram = std::move( pending_[node].dgram );
+      const uint64_t queued_at = pending_[node].queued_at;
+      const uint32_t next = pending_[node].next;
+      free_node( node );
+      f( dgram, queued_at );
+      node = next;
+    }
+  }
+
+  // Drop the neighbor's pending datagrams
+  void drop_pending( Neighbor& neighbor );
+
+  // Datagrams (and their bytes) pending for all neighbors
+  size_t pending_datagrams() const { return pending_datagrams_; }
+  size_t pending_bytes() const { return pending_bytes_; }
+
+private:
+  struct PendingNode
+  {
+    InternetDatagram dgram {};
+    uint64_t queued_at {};
+    uint32_t bytes {};
+    uint32_t next { NONE };
+  };
+
+  size_t home( uint32_t ip ) const;
+  void grow();
+  void free_node( uint32_t node );
+
+  std::vector<Neighbor> slots_ = std::vector<Neighbor>( 16 );
+  size_t size_ {};
+
+  std::vector<PendingNode> pending_ {};
+  std::vector<uint32_t> free_nodes_ {};
+  size_t pending_datagrams_ {};
+  size_t pending_bytes_ {};
+};
@@ -9,6 +9,18 @@
 
 using namespace std;
 
+namespace {
+// The size of a datagram on the wire
+uint32_t datagram_size( const InternetDatagram& dgram )
+{
+  size_t size = IPv4Header::LENGTH;
+  for ( const auto& buf : dgram.payload ) {
+    size += buf->size();
+  }
+  return static_cast<uint32_t>( size );
+}
+} // namespace
+
 //! \param[in] ethernet_address Ethernet (what ARP calls "hardware") address of the interface
 //! \param[in] ip_address IP (what ARP calls "protocol") address of the interface
 NetworkInterface::NetworkInterface( string_view name,
@@ -21,9 +33,6 @@ NetworkInterface::NetworkInterface( string_view name,
   , ip_address_( ip_address )
   , datagrams_received_()
   , time_ms_{0}
-  , arp_table_()
-  , pending_datagrams_()
-  , arp_request_timer_()
 {
   cerr << "DEBUG: Network interface has Ethernet address " << to_string( ethernet_address_ ) << " and IP address "
        << ip_address.ip() << "\n";
@@ -34,52 +43,182 @@ NetworkInterface::NetworkInterface( string_view name,
 //! may also be another host if directly connected to the same network as the destination) Note: the Address type
 //! can be converted to a uint32_t (raw 32-bit IP address) by using the Address::ipv4_numeric() method.
 void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Address& next_hop )
+{
+  NeighborTable::Neighbor* neighbor = neighbors_.find( next_hop.ipv4_numeric() );
+  if ( neighbor != nullptr && neighbor->resolved ) {
+    neighbor->used_at = time_ms_;
+    transmit_datagram( dgram, neighbor->ethernet_address );
+    return;
+  }
+
+  // 要排队等 ARP 回复的话，得有一份自己的拷贝
+  send_datagram( clone( dgram ), next_hop );
+}
+
+void NetworkInterface::send_datagram( InternetDatagram&& dgram, const Address& next_hop )
 {
   const uint32_t next_hop_ip = next_hop.ipv4_numeric();
 
-  // 1. 在 ARP 表中查找下一跳 IP 对应的 MAC 地址
-  auto arp_entry = arp_table_.find( next_hop_ip );
+  // 1. 在 ARP 缓存中查找下一跳 IP 对应的 MAC 地址
+  NeighborTable::Neighbor* neighbor = neighbors_.find( next_hop_ip );
 
-  if ( arp_entry != arp_table_.end() ) {
+  if ( neighbor != nullptr && neighbor->resolved ) {
     // --- 情况 A: 找到了 (Cache Hit) ---
-    const EthernetAddress& dest_mac = arp_entry->second.first;
+    const EthernetAddress& dest_mac = neighbor->ethernet_address;
 
-    // 封装成以太网帧并发送
-    EthernetFrame frame;
-    frame.header.src = ethernet_address_;
-    frame.header.dst = dest_mac;
-    frame.header.type = EthernetHeader::TYPE_IPv4;
-    frame.payload = serialize(dgram); ////
-    transmit( frame );
+    // 封装成以太网帧并发送（记下使用时间，决定快过期时要不要刷新）
+    neighbor->used_at = time_ms_;
+    transmit_datagram( dgram, dest_mac );
 
   } else {
     // --- 情况 B: 没找到 (Cache Miss) ---
 
+    if ( neighbor == nullptr ) {
+      neighbor = &neighbors_.find_or_insert( next_hop_ip );
+    }
+
     // 2. 检查是否在冷却时间内发送过 ARP 请求
-    if ( arp_request_timer_.find( next_hop_ip ) == arp_request_timer_.end() ) {
-      // 如果不在冷却期 (即没找到计时器记录)，则发送一个新的 ARP 请求
-      ARPMessage arp_request;
-      arp_request.opcode = ARPMessage::OPCODE_REQUEST;
-      arp_request.sender_ethernet_address = ethernet_address_;
-      arp_request.sender_ip_address = ip_address_.ipv4_numeric();
-      arp_request.target_ip_address = next_hop_ip;
-      // target_ethernet_address 默认为 00:00:00:00:00:00，不需要设置
-
-      // 封装 ARP 请求到以太网帧中，目的地是广播地址
-      EthernetFrame frame;
-      frame.header.src = ethernet_address_;
-      frame.header.dst = ETHERNET_BROADCAST; // 广播
-      frame.header.type = EthernetHeader::TYPE_ARP;
-      frame.payload = serialize(arp_request);
-      transmit( frame );
+    if ( !neighbor->requesting ) {
+      // 如果不在冷却期 (即没找到计时器记录)，则广播一个新的 ARP 请求
+      send_arp_request( next_hop_ip, ETHERNET_BROADCAST );
 
       // 记录本次请求时间，启动 5 秒冷却
-      arp_request_timer_[next_hop_ip] = time_ms_ + ARP_REQUEST_COOLDOWN_MS;
+      neighbor->requesting = true;
+      neighbor->request_expires_at = time_ms_ + ARP_REQUEST_COOLDOWN_MS;
+      timers_.schedule( neighbor->request_expires_at, { next_hop_ip, ArpTimer::Kind::REQUEST } );
+    }
+
+    // 3. 无论是否发送了新的 ARP 请求，都需要把这个 IP 数据报暂存起来（等待队列满了就按策略丢弃）
+    const uint32_t bytes = datagram_size( dgram );
+    if ( !make_room( *neighbor, bytes ) ) {
+      ++pending_stats_.datagrams_dropped;
+      pending_stats_.bytes_dropped += bytes;
+      return;
+    }
+    neighbors_.push_pending( *neighbor, move( dgram ), bytes, time_ms_ );
+  }
+}
+
+void NetworkInterface::send_arp_request( const uint32_t target_ip, const EthernetAddress& dst )
+{
+  ARPMessage arp_request;
+  arp_request.opcode = ARPMessage::OPCODE_REQUEST;
+  arp_request.sender_ethernet_address = ethernet_address_;
+  arp_request.sender_ip_address = ip_address_.ipv4_numeric();
+  arp_request.target_ip_address = target_ip;
+  // target_ethernet_address 默认为 00:00:00:00:00:00，不需要设置
+
+  // 封装 ARP 请求到以太网帧中
+  EthernetFrame frame;
+  frame.header.src = ethernet_address_;
+  frame.header.dst = dst;
+  frame.header.type = EthernetHeader::TYPE_ARP;
+  frame.payload = serialize( arp_request );
+  transmit( frame );
+}
+
+bool NetworkInterface::make_room( NeighborTable::Neighbor& neighbor, const uint32_t bytes )
+{
+  const auto fits = [&] {
+    return neighbor.pending_datagrams < pending_limits_.max_datagrams_per_neighbor
+           && neighbor.pending_bytes + bytes <= pending_limits_.max_bytes_per_neighbor
+           && neighbors_.pending_datagrams() < pending_limits_.max_datagrams
+           && neighbors_.pending_bytes() + bytes <= pending_limits_.max_bytes;
+  };
+
+  // DROP_HEAD：丢弃这个邻居最早排队的数据报，直到放得下为止（不动其他邻居的队列）
+  if ( pending_limits_.policy == DropPolicy::DROP_HEAD ) {
+    while ( !fits() && neighbor.pending_datagrams > 0 ) {
+      ++pending_stats_.datagrams_dropped;
+      pending_stats_.bytes_dropped += neighbors_.pop_pending( neighbor );
+    }
+  }
+
+  return fits();
+}
+
+// Send a datagram in an Ethernet frame without allocating: the IP header is written into a reused string, the
+// frame (and its list of payload buffers) is reused too, and the datagram's payload is only borrowed. (An
+// OutputPort that keeps a frame must copy it, as the frame is overwritten by the next one.)
+void NetworkInterface::transmit_datagram( const InternetDatagram& dgram, const EthernetAddress& dst )
+{
+  if ( datagram_size( dgram ) > mtu_ ) {
+    transmit_fragments( dgram, dst );
+    return;
+  }
+
+  start_frame( dgram.header, dst );
+  for ( const auto& buf : dgram.payload ) {
+    if ( not buf.get().empty() ) {
+      tx_frame_.payload.push_back( buf.borrow() );
+    }
+  }
+
+  transmit( tx_frame_ );
+}
+
+// Send a datagram that is larger than the MTU as fragments (RFC 791 section 3.2): each carries as many bytes of
+// the payload as fit (a multiple of 8, except in the last one), copied into a reused string.
+void NetworkInterface::transmit_fragments( const InternetDatagram& dgram, const EthernetAddress& dst )
+{
+  if ( dgram.header.df ) {
+    ++fragment_stats_.datagrams_too_big;
+    return;
+  }
+
+  const size_t total = datagram_size( dgram ) - IPv4Header::LENGTH;
+  const size_t max_piece = ( mtu_ - IPv4Header::LENGTH ) / 8 * 8;
+
+  IPv4Header header = dgram.header;
+  header.hlen = IPv4Header::LENGTH / 4;
+  size_t buffer = 0; // where the next byte of the payload is
+  size_t skip = 0;
+  for ( size_t position = 0; position < total; position += max_piece ) {
+    const size_t piece = min( max_piece, total - position );
+    tx_fragment_.clear();
+    while ( tx_fragment_.size() < piece ) {
+      const string& buf = dgram.payload.at( buffer ).get();
+      const size_t length = min( buf.size() - skip, piece - tx_fragment_.size() );
+      tx_fragment_.append( buf, skip, length );
+      skip += length;
+      if ( skip == buf.size() ) {
+        ++buffer;
+        skip = 0;
+      }
     }
 
-    // 3. 无论是否发送了新的 ARP 请求，都需要把这个 IP 数据报暂存起来
-    pending_datagrams_[next_hop_ip].emplace_back( dgram, time_ms_ );
+    // (a fragment of a fragment keeps its place in the original datagram)
+    header.offset = static_cast<uint16_t>( dgram.header.offset + position / 8 );
+    header.mf = dgram.header.mf or position + piece < total;
+    header.len = static_cast<uint16_t>( IPv4Header::LENGTH + piece );
+    header.compute_checksum();
+
+    start_frame( header, dst );
+    tx_frame_.payload.push_back( borrow( tx_fragment_ ) );
+    transmit( tx_frame_ );
+    ++fragment_stats_.fragments_sent;
+  }
+  ++fragment_stats_.datagrams_fragmented;
+}
+
+void NetworkInterface::start_frame( const IPv4Header& header, const EthernetAddress& dst )
+{
+  tx_ip_header_.resize( IPv4Header::LENGTH );
+  Serializer serializer { tx_ip_header_ };
+  header.serialize( serializer );
+  tx_ip_header_.resize( serializer.arena_contents().size() );
+
+  tx_frame_.header = { .dst = dst, .src = ethernet_address_, .type = EthernetHeader::TYPE_IPv4 };
+  tx_frame_.payload.clear();
+  tx_frame_.payload.push_back( borrow( tx_ip_header_ ) );
+}
+
+void NetworkInterface::set_mtu( const size_t mtu )
+{
+  if ( mtu < MIN_MTU ) {
+    throw runtime_error( "NetworkInterface: MTU " + to_string( mtu ) + " is smaller than " + to_string( MIN_MTU ) );
   }
+  mtu_ = mtu;
 }
 
 void NetworkInterface::recv_frame( EthernetFrame frame ){
@@ -93,35 +232,45 @@ void NetworkInterface::recv_frame( EthernetFrame frame ){
     // --- 情况 A: 收到 IPv4 数据报 ---
     InternetDatagram dgram;
     if ( parse(dgram, frame.payload)) {
-      // 解析成功，放入接收队列，供上层协议栈处理
-      datagrams_received_.push( move( dgram ) );
+      // 解析成功，放入接收队列，供上层协议栈处理（如果要重组分片，凑齐了才放入）
+      if ( reassemble_ && FragmentReassembler::is_fragment( dgram.header ) ) {
+        optional<InternetDatagram> whole = reassembler_.insert( move( dgram ), time_ms_ );
+        if ( whole.has_value() ) {
+          datagrams_received_.push( move( *whole ) );
+        }
+      } else {
+        datagrams_received_.push( move( dgram ) );
+      }
     }
 
   } else if ( frame.header.type == EthernetHeader::TYPE_ARP ) {
     // --- 情况 B: 收到 ARP 消息 ---
     ARPMessage arp_msg;
     if (parse( arp_msg, frame.payload ) ){
-      // a. 学习地址：将发送方的 IP-MAC 映射存入 ARP 表，并设置 30 秒过期时间
-      arp_table_[arp_msg.sender_ip_address] = { arp_msg.sender_ethernet_address, time_ms_ + ARP_MAPPING_TTL_MS };
-
-      // b. 发送待处理的数据报：检查是否有数据报正在等待这个刚学到的地址
-      if ( pending_datagrams_.count( arp_msg.sender_ip_address ) ) {
-        // 遍历所有等待这个 IP 的数据报
-        for ( const auto& [dgram, timestamp] : pending_datagrams_.at( arp_msg.sender_ip_address ) ) {
-          // 现在我们知道 MAC 地址了，直接发送
-          //只发送没过期的
-          if(time_ms_ - timestamp <= ARP_MAPPING_TTL_MS){
-            EthernetFrame pending_frame;
-            pending_frame.header.src = ethernet_address_;
-            pending_frame.header.dst = arp_msg.sender_ethernet_address;
-            pending_frame.header.type = EthernetHeader::TYPE_IPv4;
-            pending_frame.payload = serialize(dgram);
-            transmit( pending_frame );
-          }
+      // a. 学习地址：将发送方的 IP-MAC 映射存入 ARP 缓存，并设置 30 秒过期时间
+      NeighborTable::Neighbor& neighbor = neighbors_.find_or_insert( arp_msg.sender_ip_address );
+      neighbor.resolved = true;
+      neighbor.ethernet_address = arp_msg.sender_ethernet_address;
+      neighbor.expires_at = time_ms_ + ARP_MAPPING_TTL_MS;
+      timers_.schedule( neighbor.expires_at, { arp_msg.sender_ip_address, ArpTimer::Kind::MAPPING } );
+      timers_.schedule( neighbor.expires_at - ARP_REFRESH_LEAD_MS,
+                        { arp_msg.sender_ip_address, ArpTimer::Kind::REFRESH } );
 
+      // b. 发送待处理的数据报：现在知道 MAC 地址了，按到达顺序发出等待这个地址的数据报，然后清空等待队列
+      //    （输出端口可能重入 send_datagram 而改动邻居表，所以发送时不再引用 neighbor，发完再重新查找）
+      bool sent = false;
+      neighbors_.drain_pending( neighbor, [&]( const InternetDatagram& dgram, uint64_t timestamp ) {
+        //只发送没过期的
+        if(time_ms_ - timestamp <= ARP_MAPPING_TTL_MS){
+          sent = true;
+          transmit_datagram( dgram, arp_msg.sender_ethernet_address );
+        } else {
+          ++pending_stats_.datagrams_expired;
         }
-        // 发送完毕，清空等待队列
-        pending_datagrams_.erase( arp_msg.sender_ip_address );
+      } );
+      NeighborTable::Neighbor* const drained = neighbors_.find( arp_msg.sender_ip_address );
+      if ( sent and drained ) {
+        drained->used_at = time_ms_;
       }
 
       // c. 响应 ARP 请求：如果这是一个对我的 ARP 请求，则回复
@@ -151,32 +300,44 @@ void NetworkInterface::tick( const size_t ms_since_last_tick )
   // 1. 更新内部时钟
   time_ms_ += ms_since_last_tick;
 
-  // 2. 清理过期的 ARP 映射
-  // // C++20 的 erase_if 写法，非常简洁
-  // std::erase_if( arp_table_, [this]( const auto& item ) {
-  //   // item 是一个 map 里的键值对，item.first 是 IP, item.second 是 {MAC, 过期时间}
-  //   auto const& [ip_addr, pair] = item;
-  //   return time_ms_ >= pair.second; // 如果当前时间超过了过期时间，就删除
-  // } );
-  
-  
-  // (也可以用传统的迭代器方式删除，效果一样)
-  for (auto it = arp_table_.begin(); it != arp_table_.end(); ) {
-    if (time_ms_ >= it->second.second) {
-      it = arp_table_.erase(it);
-    } else {
-      ++it;
-    }
+  // 丢弃超时仍未凑齐的分片
+  if ( reassemble_ ) {
+    reassembler_.expire( time_ms_ );
   }
 
-  // 2. 新增：清理过期的 ARP 请求计时器
-  for (auto it = arp_request_timer_.begin(); it != arp_request_timer_.end(); ) {
-    if (time_ms_ >= it->second) {
-      pending_datagrams_.erase(it->first);
-      it = arp_request_timer_.erase(it);
-    } else {
-      ++it;
+  // 2. 处理到期的定时：过期的 ARP 映射被删除；请求冷却结束时，仍在等待的数据报被丢弃；
+  //    快过期而最近还在用的映射，单播一个 ARP 请求去刷新（邻居的回复会重新设定过期时间）。
+  //    (定时无法取消，所以先核对表项里当前的过期时间，不一致说明该定时已经作废)
+  timers_.advance( time_ms_, [this]( const ArpTimer& timer, uint64_t deadline ) {
+    NeighborTable::Neighbor* neighbor = neighbors_.find( timer.ip );
+    if ( neighbor == nullptr ) {
+      return;
     }
-    cerr<<"debug"<<endl;
-  }
+
+    switch ( timer.kind ) {
+      case ArpTimer::Kind::REQUEST:
+        if ( neighbor->requesting && neighbor->request_expires_at == deadline ) {
+          neighbor->requesting = false;
+          pending_stats_.datagrams_expired += neighbor->pending_datagrams;
+          neighbors_.drop_pending( *neighbor );
+        }
+        break;
+      case ArpTimer::Kind::MAPPING:
+        if ( neighbor->resolved && neighbor->expires_at == deadline ) {
+          neighbor->resolved = false;
+        }
+        break;
+      case ArpTimer::Kind::REFRESH:
+        // (时钟一下子跳过了过期时间的话，映射已经没用了，不必刷新)
+        if ( neighbor->resolved && neighbor->expires_at - ARP_REFRESH_LEAD_MS == deadline
+             && time_ms_ < neighbor->expires_at && time_ms_ < neighbor->used_at + ARP_REFRESH_RECENT_MS ) {
+          send_arp_request( timer.ip, neighbor->ethernet_address );
+        }
+        break;
+    }
+
+    if ( !neighbor->resolved && !neighbor->requesting ) {
+      neighbors_.erase( timer.ip );
+    }
+  } );
 }
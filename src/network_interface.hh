@@ -2,11 +2,14 @@
 
 #include "address.hh"
 #include "ethernet_frame.hh"
+#include "fragment_reassembler.hh"
 #include "ipv4_datagram.hh"
+#include "neighbor_table.hh"
+#include "spsc_ring.hh"
+#include "timer_wheel.hh"
 
 #include <memory>
 #include <queue>
-#include <map>
 #include <iostream>
 
 using namespace std;
@@ -43,6 +46,44 @@ public:
     virtual ~OutputPort() = default;
   };
 
+  // Bounds on the datagrams queued while waiting for ARP replies, per neighbor and for the whole interface. When
+  // queueing a datagram would exceed one, the policy decides what is dropped: the new datagram (DROP_TAIL), or
+  // the oldest datagrams queued for the same neighbor, as many as it takes (DROP_HEAD). A datagram that can't fit
+  // even then is dropped.
+  enum class DropPolicy : uint8_t
+  {
+    DROP_TAIL,
+    DROP_HEAD
+  };
+
+  struct PendingLimits
+  {
+    size_t max_datagrams_per_neighbor { 64 };
+    size_t max_bytes_per_neighbor { 256 * 1024 };
+    size_t max_datagrams { 4096 };
+    size_t max_bytes { 16 * 1024 * 1024 };
+    DropPolicy policy { DropPolicy::DROP_TAIL };
+  };
+
+  // What became of datagrams that were queued (or would have been) but never sent
+  struct PendingStats
+  {
+    uint64_t datagrams_dropped {}; // for lack of room
+    uint64_t bytes_dropped {};
+    uint64_t datagrams_expired {}; // the neighbor never answered
+  };
+
+  // What became of datagrams larger than the MTU
+  struct FragmentStats
+  {
+    uint64_t datagrams_fragmented {};
+    uint64_t fragments_sent {};
+    uint64_t datagrams_too_big {}; // dropped: larger than the MTU, and not to be fragmented
+  };
+
+  static constexpr size_t DEFAULT_MTU = 1500;
+  static constexpr size_t MIN_MTU = 68; // (RFC 791: every IPv4 link must carry datagrams this large)
+
   // Construct a network interface with given Ethernet (network-access-layer) and IP (internet-layer)
   // addresses
   NetworkInterface( std::string_view name,
@@ -55,6 +96,10 @@ public:
   //hop. Sending is accomplished by calling `transmit()` (a member variable) on the frame.
   void send_datagram( const InternetDatagram& dgram, const Address& next_hop );
 
+  // The same, taking ownership of the datagram: if it has to wait for an ARP reply, it is queued without copying
+  // its payload. (The other overload copies the datagram if it has to be queued.)
+  void send_datagram( InternetDatagram&& dgram, const Address& next_hop );
+
   // Receives an Ethernet frame and responds appropriately.
   // If type is IPv4, pushes the datagram to the datagrams_in queue.
   // If type is ARP request, learn a mapping from the "sender" fields, and send an ARP reply.
@@ -64,11 +109,27 @@ public:
   // Called periodically when time elapses
   void tick( size_t ms_since_last_tick );
 
+  // Change the bounds on queued datagrams (those already queued are kept)
+  void set_pending_limits( const PendingLimits& limits ) { pending_limits_ = limits; }
+
+  // Set the largest datagram (header included) sent in one frame. Larger datagrams are split into fragments, or
+  // dropped if their "don't fragment" flag is set.
+  void set_mtu( size_t mtu );
+
+  // Put fragmented datagrams back together before passing them up the stack, instead of passing up the
+  // fragments (off by default: a router forwards fragments as they are, and only the destination reassembles)
+  void set_reassemble_fragments( bool reassemble ) { reassemble_ = reassemble; }
+
   // Accessors
   const std::string& name() const { return name_; }
   const OutputPort& output() const { return *port_; }
   OutputPort& output() { return *port_; }
-  std::queue<InternetDatagram>& datagrams_received() { return datagrams_received_; }
+  SPSCRing<InternetDatagram>& datagrams_received() { return datagrams_received_; }
+  const PendingLimits& pending_limits() const { return pending_limits_; }
+  const PendingStats& pending_stats() const { return pending_stats_; }
+  size_t mtu() const { return mtu_; }
+  const FragmentStats& fragment_stats() const { return fragment_stats_; }
+  const FragmentReassembler& reassembler() const { return reassembler_; }
 
 private:
   // Human-readable name of the interface
@@ -78,35 +139,65 @@ private:
   std::shared_ptr<OutputPort> port_;
   void transmit( const EthernetFrame& frame ) const { port_->transmit( *this, frame ); }
 
+  // Send a datagram to a neighbor whose Ethernet address is known (reusing tx_frame_ and tx_ip_header_), in
+  // fragments if it is larger than the MTU
+  void transmit_datagram( const InternetDatagram& dgram, const EthernetAddress& dst );
+  void transmit_fragments( const InternetDatagram& dgram, const EthernetAddress& dst );
+  void start_frame( const IPv4Header& header, const EthernetAddress& dst ); // tx_frame_ with just the header
+  EthernetFrame tx_frame_ {};
+  std::string tx_ip_header_ {};
+  std::string tx_fragment_ {};
+
+  size_t mtu_ { DEFAULT_MTU };
+  FragmentStats fragment_stats_ {};
+  bool reassemble_ {};
+  FragmentReassembler reassembler_ {};
+
   // Ethernet (known as hardware, network-access-layer, or link-layer) address of the interface
   EthernetAddress ethernet_address_;
 
   // IP (known as internet-layer or network-layer) address of the interface
   Address ip_address_;
 
-  // Datagrams that have been received
-  std::queue<InternetDatagram> datagrams_received_ {};
+  // Datagrams that have been received (a ring that may be handed to a consumer on another thread, see
+  // SPSCRing::set_fixed_capacity)
+  SPSCRing<InternetDatagram> datagrams_received_ {};
 
   // 内部时钟，记录从开始到现在的总毫秒数
   size_t time_ms_ {0};
 
-  // ARP 缓存表：存储 IP 地址 -> {MAC 地址, 过期时间点} 的映射
-  // key: 32位的IP地址 (uint32_t)
-  // value: 一个包含 MAC 地址和此条目过期绝对时间的 pair
-  std::map<uint32_t, std::pair<EthernetAddress, size_t>> arp_table_;
+  // ARP 缓存：每个邻居的 MAC 地址及其过期时间、ARP 请求冷却期、等待该地址的数据报队列，都在同一个表项里
+  NeighborTable neighbors_ {};
+
+  // 等待队列的上限和丢弃统计
+  PendingLimits pending_limits_ {};
+  PendingStats pending_stats_ {};
+
+  // 按照上限和丢弃策略，为一个 `bytes` 字节的新数据报腾出位置；腾不出来则返回 false
+  bool make_room( NeighborTable::Neighbor& neighbor, uint32_t bytes );
 
-  // 等待 ARP 回复的 IP 数据报队列
-  // 当我们不知道下一跳的 MAC 地址时，把目标是这个 IP 的数据报暂存在这里
-  // key: 32位的下一跳IP地址 (uint32_t)
-  // value: 等待发送到该 IP 的数据报列表和时间戳
-  std::map<uint32_t, std::vector<std::pair<InternetDatagram, size_t>>> pending_datagrams_;
+  // 发送 ARP 请求：dst 为广播地址（解析新邻居），或邻居已知的 MAC 地址（单播刷新快要过期的映射）
+  void send_arp_request( uint32_t target_ip, const EthernetAddress& dst );
 
-  // ARP 请求节流阀：防止对同一个 IP 地址频繁发送 ARP 请求
-  // key: 32位的目标IP地址 (uint32_t)
-  // value: 上次为这个 IP 发送 ARP 请求的时间点
-  std::map<uint32_t, size_t> arp_request_timer_;
+  // 到期事件：ARP 映射过期、ARP 请求冷却结束、该刷新映射了（时间轮，不必每次 tick 都扫描整张表）
+  struct ArpTimer
+  {
+    enum class Kind : uint8_t
+    {
+      MAPPING, // 映射过期
+      REQUEST, // 请求冷却结束
+      REFRESH  // 映射快过期：如果最近还在用，就提前单播一个 ARP 请求，免得下一个数据报要等一整轮 ARP
+    };
+    uint32_t ip;
+    Kind kind;
+  };
+  TimerWheel<ArpTimer> timers_ { TIMER_RESOLUTION_MS, TIMER_SLOTS };
 
   // --- 定义一些常量，方便代码编写和阅读 ---
   static constexpr size_t ARP_MAPPING_TTL_MS = 30000;      // ARP 映射的存活时间：30秒
   static constexpr size_t ARP_REQUEST_COOLDOWN_MS = 5000; // ARP 请求的冷却时间：5秒
+  static constexpr size_t ARP_REFRESH_LEAD_MS = 5000;    // 在映射过期前 5 秒刷新
+  static constexpr size_t ARP_REFRESH_RECENT_MS = 10000; // 只刷新最近 10 秒内用过的映射
+  static constexpr size_t TIMER_RESOLUTION_MS = 128;      // 时间轮每格 128 毫秒
+  static constexpr size_t TIMER_SLOTS = 256;              // 转一圈约 32.8 秒，长于最长的定时
 };
@@ -0,0 +1,290 @@
+#include "prefix_table.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined( __x86_64__ )
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+// Number of address bits consumed by the end of each level of the trie
+constexpr array<unsigned, 3> LEVEL_END { 16, 24, 32 };
+
+uint32_t mask( const uint8_t prefix_length )
+{
+  return prefix_length == 0 ? 0 : ~0U << ( 32 - prefix_length );
+}
+
+uint64_t key( const uint32_t route_prefix, const uint8_t prefix_length )
+{
+  return uint64_t { prefix_length } << 32 | route_prefix;
+}
+
+uint8_t depth( const uint32_t entry )
+{
+  return ( entry >> 24 ) & 0x3f;
+}
+
+// Addresses resolved per call of the kernel (enough loads in flight to cover a cache miss)
+constexpr size_t BATCH_SIZE = 64;
+
+// Gathers only win while the table is mostly in cache; beyond that, the loads miss anyway and the scalar kernel's
+// prefetches (which keep more misses in flight) are faster. This also keeps the gathers' 32-bit signed offsets
+// in range.
+constexpr size_t MAX_GATHER_TABLE_BYTES = 4UL << 20;
+} // namespace
+
+PrefixTable::PrefixTable() : top_( 1UL << LEVEL_END[0] ) {}
+
+bool PrefixTable::Change::applies_to( const Entry entry ) const
+{
+  if ( inserting ) {
+    // a longer prefix already covering this entry takes precedence
+    return not( entry & VALID ) or depth( entry ) <= prefix_length;
+  }
+  // only the entries that belong to the prefix being erased
+  return ( entry & VALID ) and depth( entry ) == prefix_length;
+}
+
+void PrefixTable::lookup_batch( span<const uint32_t> addresses, span<optional<uint32_t>> results ) const
+{
+  if ( results.size() < addresses.size() ) {
+    throw runtime_error( "PrefixTable::lookup_batch: results smaller than addresses" );
+  }
+
+  using Resolver = void ( * )( const Entry*, const Entry*, const uint32_t*, Entry*, size_t );
+  static const Resolver fastest = [] {
+#if defined( __x86_64__ )
+    if ( __builtin_cpu_supports( "avx2" ) ) {
+      return &resolve_avx2;
+    }
+#endif
+    return &resolve_scalar;
+  }();
+  const Resolver resolve = memory_usage() <= MAX_GATHER_TABLE_BYTES ? fastest : &resolve_scalar;
+  const Entry* groups = groups_.empty() ? nullptr : groups_.front().data();
+
+  array<Entry, BATCH_SIZE> entries {};
+  for ( size_t first = 0; first < addresses.size(); first += BATCH_SIZE ) {
+    const size_t count = min( BATCH_SIZE, addresses.size() - first );
+    resolve( top_.data(), groups, addresses.data() + first, entries.data(), count );
+    for ( size_t i = 0; i < count; ++i ) {
+      if ( entries[i] & VALID ) {
+        results[first + i] = entries[i] & INDEX_MASK;
+      } else {
+        results[first + i].reset();
+      }
+    }
+  }
+}
+
+// Level by level: prefetch every address's entry, then load them all (by then most are on their way)
+void PrefixTable::resolve_scalar( const Entry* top,
+                                  const Entry* groups,
+                                  const uint32_t* addresses,
+                                  Entry* entries,
+                                  const size_t count )
+{
+  for ( size_t i = 0; i < count; ++i ) {
+    __builtin_prefetch( top + ( addresses[i] >> 16 ) );
+  }
+  for ( size_t i = 0; i < count; ++i ) {
+    entries[i] = top[addresses[i] >> 16];
+  }
+
+  // in the two lower levels, an extended entry's group is indexed by the next byte of the address
+  for ( const unsigned shift : { 8U, 0U } ) {
+    const auto offset = [&]( size_t i ) {
+      return size_t { entries[i] & INDEX_MASK } * tuple_size_v<Group> + ( ( addresses[i] >> shift ) & 0xff );
+    };
+    for ( size_t i = 0; i < count; ++i ) {
+      if ( entries[i] & EXTENDED ) {
+        __builtin_prefetch( groups + offset( i ) );
+      }
+    }
+    for ( size_t i = 0; i < count; ++i ) {
+      if ( entries[i] & EXTENDED ) {
+        entries[i] = groups[offset( i )];
+      }
+    }
+  }
+}
+
+#if defined( __x86_64__ )
+// Eight addresses at a time with AVX2 gathers. EXTENDED is the sign bit, so the entries themselves serve as the
+// gather mask for the lower levels: lanes that are already resolved are left alone.
+__attribute__( ( target( "avx2" ) ) ) void PrefixTable::resolve_avx2( const Entry* top,
+                                                                     const Entry* groups,
+                                                                     const uint32_t* addresses,
+                                                                     Entry* entries,
+                                                                     const size_t count )
+{
+  static_assert( EXTENDED == 1U << 31 and sizeof( Group ) == tuple_size_v<Group> * sizeof( Entry ) );
+
+  const __m256i index_mask = _mm256_set1_epi32( static_cast<int>( INDEX_MASK ) );
+  const __m256i byte_mask = _mm256_set1_epi32( 0xff );
+  const auto* top_base = reinterpret_cast<const int*>( top );       // NOLINT
+  const auto* groups_base = reinterpret_cast<const int*>( groups ); // NOLINT
+
+  size_t i = 0;
+  for ( ; i + 8 <= count; i += 8 ) {
+    const __m256i address = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( addresses + i ) ); // NOLINT
+    __m256i entry = _mm256_i32gather_epi32( top_base, _mm256_srli_epi32( address, 16 ), 4 );
+
+    for ( const int shift : { 8, 0 } ) {
+      if ( _mm256_movemask_ps( _mm256_castsi256_ps( entry ) ) == 0 ) {
+        break; // no lane is extended
+      }
+      const __m256i group = _mm256_slli_epi32( _mm256_and_si256( entry, index_mask ), 8 );
+      const __m256i next_byte = _mm256_srl_epi32( address, _mm_cvtsi32_si128( shift ) );
+      const __m256i byte = _mm256_and_si256( next_byte, byte_mask );
+      entry = _mm256_mask_i32gather_epi32( entry, groups_base, _mm256_or_si256( group, byte ), entry, 4 );
+    }
+
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( entries + i ), entry ); // NOLINT
+  }
+
+  resolve_scalar( top, groups, addresses + i, entries + i, count - i );
+}
+#endif
+
+void PrefixTable::insert( uint32_t route_prefix, const uint8_t prefix_length, const uint32_t value )
+{
+  if ( prefix_length > 32 ) {
+    throw runtime_error( "PrefixTable: prefix length greater than 32" );
+  }
+  if ( value > MAX_VALUE ) {
+    throw runtime_error( "PrefixTable: value too large" );
+  }
+
+  route_prefix &= mask( prefix_length );
+  prefixes_[key( route_prefix, prefix_length )] = value;
+
+  const Entry entry = VALID | uint32_t { prefix_length } << 24 | value;
+  update( TOP, 0, route_prefix, { .prefix_length = prefix_length, .replacement = entry, .inserting = true } );
+}
+
+bool PrefixTable::erase( uint32_t route_prefix, const uint8_t prefix_length )
+{
+  if ( prefix_length > 32 ) {
+    return false;
+  }
+
+  route_prefix &= mask( prefix_length );
+  if ( prefixes_.erase( key( route_prefix, prefix_length ) ) == 0 ) {
+    return false;
+  }
+
+  // the entries fall back to the longest remaining prefix that covers this one (if any)
+  Entry fallback = 0;
+  for ( int len = prefix_length - 1; len >= 0; --len ) {
+    const auto shorter = static_cast<uint8_t>( len );
+    const auto it = prefixes_.find( key( route_prefix & mask( shorter ), shorter ) );
+    if ( it != prefixes_.end() ) {
+      fallback = VALID | uint32_t { shorter } << 24 | it->second;
+      break;
+    }
+  }
+
+  update( TOP, 0, route_prefix, { .prefix_length = prefix_length, .replacement = fallback, .inserting = false } );
+  return true;
+}
+
+optional<uint32_t> PrefixTable::find( const uint32_t route_prefix, const uint8_t prefix_length ) const
+{
+  if ( prefix_length > 32 ) {
+    return {};
+  }
+  const auto it = prefixes_.find( key( route_prefix & mask( prefix_length ), prefix_length ) );
+  if ( it == prefixes_.end() ) {
+    return {};
+  }
+  return it->second;
+}
+
+// Rewrite the entries covered by route_prefix in `group` (a table of the given level), descending into
+// (and if necessary creating) the group below when the prefix is longer than this level
+void PrefixTable::update( const uint32_t group,
+                          const unsigned level,
+                          const uint32_t route_prefix,
+                          const Change& change )
+{
+  const unsigned end = LEVEL_END.at( level );
+  const unsigned stride = level == 0 ? end : end - LEVEL_END.at( level - 1 );
+  const uint32_t index = ( route_prefix >> ( 32 - end ) ) & ( ( 1U << stride ) - 1 );
+
+  if ( change.prefix_length <= end ) {
+    apply( group, level, index, 1U << ( end - change.prefix_length ), change );
+    return;
+  }
+
+  if ( not( slot( group, index ) & EXTENDED ) ) {
+    if ( not change.inserting ) {
+      return;
+    }
+    const uint32_t child = allocate_group( slot( group, index ) ); // (may move the groups)
+    slot( group, index ) = EXTENDED | child;
+  }
+
+  update( slot( group, index ) & INDEX_MASK, level + 1, route_prefix, change );
+  compact( group, level, index );
+}
+
+// Rewrite entries [first, first + count) of `group`, and every group below them
+void PrefixTable::apply( const uint32_t group,
+                         const unsigned level,
+                         const uint32_t first,
+                         const uint32_t count,
+                         const Change& change )
+{
+  for ( uint32_t i = first; i < first + count; ++i ) {
+    const Entry entry = slot( group, i );
+    if ( entry & EXTENDED ) {
+      apply( entry & INDEX_MASK, level + 1, 0, tuple_size_v<Group>, change );
+      compact( group, level, i );
+    } else if ( change.applies_to( entry ) ) {
+      slot( group, i ) = change.replacement;
+    }
+  }
+}
+
+// If the group under entry `index` of `group` now holds the same answer everywhere, and that answer comes from a
+// prefix short enough to be stored at this level, collapse it back into the entry
+void PrefixTable::compact( const uint32_t group, const unsigned level, const uint32_t index )
+{
+  const uint32_t child = slot( group, index ) & INDEX_MASK;
+  const Entry first = groups_[child][0];
+
+  if ( ( first & EXTENDED ) or ( ( first & VALID ) and depth( first ) > LEVEL_END.at( level ) ) ) {
+    return;
+  }
+  for ( const Entry entry : groups_[child] ) {
+    if ( entry != first ) {
+      return;
+    }
+  }
+
+  slot( group, index ) = first;
+  free_groups_.push_back( child );
+}
+
+uint32_t PrefixTable::allocate_group( const Entry fill )
+{
+  uint32_t index {};
+  if ( free_groups_.empty() ) {
+    if ( groups_.size() > INDEX_MASK ) {
+      throw runtime_error( "PrefixTable: too many groups" );
+    }
+    index = static_cast<uint32_t>( groups_.size() );
+    groups_.emplace_back();
+  } else {
+    index = free_groups_.back();
+    free_groups_.pop_back();
+  }
+
+  groups_[index].fill( fill );
+  return index;
+}
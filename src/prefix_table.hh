@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// \brief A longest-prefix-match table from IPv4 prefixes to small integers (e.g. indices into a list of routes).
+//
+// The lookup structure is a DIR-16-8-8 multibit trie. The top 16 bits of an address index a flat table of
+// 65536 entries; an entry whose range is split by a longer prefix instead points to a 256-entry group indexed
+// by the next 8 bits (and likewise for the last 8 bits). Every entry already holds the answer for its whole
+// range, so a lookup is at most three dependent loads, however many prefixes there are.
+//
+// Inserting or erasing a prefix only rewrites the entries it covers, and a group that becomes uniform again is
+// given back to a freelist. The prefixes themselves are also kept in a hash table, so that erase() can find the
+// next-longest prefix to fall back to.
+class PrefixTable
+{
+public:
+  static constexpr uint32_t MAX_VALUE = ( 1U << 24 ) - 1;
+
+  PrefixTable();
+
+  // Map route_prefix/prefix_length to `value`, replacing any previous value for the same prefix
+  void insert( uint32_t route_prefix, uint8_t prefix_length, uint32_t value );
+
+  // Remove route_prefix/prefix_length. Returns false if it wasn't in the table.
+  bool erase( uint32_t route_prefix, uint8_t prefix_length );
+
+  // The value stored for exactly route_prefix/prefix_length, if any
+  std::optional<uint32_t> find( uint32_t route_prefix, uint8_t prefix_length ) const;
+
+  // The value of the longest prefix that matches `address`, if any
+  std::optional<uint32_t> lookup( const uint32_t address ) const
+  {
+    Entry entry = top_[address >> 16];
+    if ( entry & EXTENDED ) {
+      entry = groups_[entry & INDEX_MASK][( address >> 8 ) & 0xff];
+      if ( entry & EXTENDED ) {
+        entry = groups_[entry & INDEX_MASK][address & 0xff];
+      }
+    }
+    if ( not( entry & VALID ) ) {
+      return {};
+    }
+    return entry & INDEX_MASK;
+  }
+
+  // Look up a batch of addresses: results[i] = lookup( addresses[i] ). The loads for the whole batch are issued
+  // one trie level at a time, so their cache misses overlap instead of being taken one after another.
+  void lookup_batch( std::span<const uint32_t> addresses, std::span<std::optional<uint32_t>> results ) const;
+
+  size_t size() const { return prefixes_.size(); }
+
+  // Bytes allocated for the lookup structure (the top-level table plus every group)
+  size_t memory_usage() const { return top_.size() * sizeof( Entry ) + groups_.size() * sizeof( Group ); }
+
+private:
+  // An entry is empty (0), a pointer to a group (EXTENDED | group index), or a match
+  // (VALID | prefix length << 24 | value).
+  using Entry = uint32_t;
+  using Group = std::array<Entry, 256>;
+
+  static constexpr Entry EXTENDED = 1U << 31;
+  static constexpr Entry VALID = 1U << 30;
+  static constexpr Entry INDEX_MASK = MAX_VALUE;
+  static constexpr uint32_t TOP = UINT32_MAX; // "group" number of the top-level table
+
+  // A pending rewrite: every entry that `applies_to` is replaced with `replacement`
+  struct Change
+  {
+    uint8_t prefix_length;
+    Entry replacement;
+    bool inserting;
+
+    bool applies_to( Entry entry ) const;
+  };
+
+  // Resolve `count` addresses to their final (non-EXTENDED) entries
+  static void resolve_scalar( const Entry* top,
+                              const Entry* groups,
+                              const uint32_t* addresses,
+                              Entry* entries,
+                              size_t count );
+#if defined( __x86_64__ )
+  static void resolve_avx2( const Entry* top,
+                            const Entry* groups,
+                            const uint32_t* addresses,
+                            Entry* entries,
+                            size_t count );
+#endif
+
+  Entry& slot( uint32_t group, uint32_t index ) { return group == TOP ? top_[index] : groups_[group][index]; }
+
+  void update( uint32_t group, unsigned level, uint32_t route_prefix, const Change& change );
+  void apply( uint32_t group, unsigned level, uint32_t first, uint32_t count, const Change& change );
+  void compact( uint32_t group, unsigned level, uint32_t index );
+  uint32_t allocate_group( Entry fill );
+
+  std::vector<Entry> top_;
+  std::vector<Group> groups_ {};
+  std::vector<uint32_t> free_groups_ {};
+  std::unordered_map<uint64_t, uint32_t> prefixes_ {}; // (prefix_length << 32 | route_prefix) => value
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// \brief A small 4-way set-associative cache of longest-prefix-match results, keyed by destination address.
+//
+// Each slot remembers one destination and the route it resolved to (or that it had none). A destination can
+// live in any of the four slots of its set, so a few hot destinations that hash to the same set don't keep
+// evicting each other. Slots are tagged with the generation they were filled in, so invalidate() (called
+// whenever the routing table changes) empties the whole cache in O(1).
+class RouteCache
+{
+public:
+  static constexpr size_t WAYS = 4;
+
+  // A cache of `size` slots (rounded up to a power of two, and at least WAYS); 0 disables the cache
+  explicit RouteCache( size_t size = 0 )
+  {
+    if ( size > 0 ) {
+      size_t sets = 1;
+      while ( sets * WAYS < size ) {
+        sets <<= 1;
+        ++index_bits_;
+      }
+      slots_.resize( sets * WAYS );
+      next_victim_.resize( sets );
+    }
+  }
+
+  bool enabled() const { return not slots_.empty(); }
+
+  // If `address` is cached, set `result` to its route (or to empty if it has none) and return true
+  bool find( const uint32_t address, std::optional<uint32_t>& result )
+  {
+    if ( not enabled() ) {
+      return false;
+    }
+
+    const Slot* set = &slots_[index( address ) * WAYS];
+    for ( size_t way = 0; way < WAYS; ++way ) {
+      const Slot& slot = set[way]; // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      if ( slot.generation == generation_ and slot.address == address ) {
+        ++hits_;
+        if ( slot.value == NO_ROUTE ) {
+          result.reset();
+        } else {
+          result = slot.value;
+        }
+        return true;
+      }
+    }
+
+    ++misses_;
+    return false;
+  }
+
+  // Remember the route (or lack of one) for `address`. It goes in an empty (or stale) slot of its set if there
+  // is one, and otherwise evicts the set's slots in turn.
+  void store( const uint32_t address, const std::optional<uint32_t> result )
+  {
+    if ( not enabled() ) {
+      return;
+    }
+
+    const size_t set = index( address );
+    size_t way = 0;
+    while ( way < WAYS and slots_[set * WAYS + way].generation == generation_
+            and slots_[set * WAYS + way].address != address ) {
+      ++way;
+    }
+    if ( way == WAYS ) {
+      way = next_victim_[set];
+      next_victim_[set] = static_cast<uint8_t>( ( way + 1 ) % WAYS );
+    }
+
+    slots_[set * WAYS + way] = { address, result.value_or( NO_ROUTE ), generation_ };
+  }
+
+  // Forget every cached result
+  void invalidate()
+  {
+    if ( ++generation_ == 0 ) { // (wrapped around: old tags could match again)
+      slots_.assign( slots_.size(), {} );
+      generation_ = 1;
+    }
+  }
+
+  // Accessors
+  size_t size() const { return slots_.size(); }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+private:
+  static constexpr uint32_t NO_ROUTE = UINT32_MAX;
+
+  struct Slot
+  {
+    uint32_t address {};
+    uint32_t value {};
+    uint32_t generation {}; // 0 = never filled
+  };
+
+  // The set for an address. (Multiplicative hashing, so that addresses differing only in their low or high bits
+  // are spread out.)
+  size_t index( const uint32_t address ) const
+  {
+    return index_bits_ == 0 ? 0 : static_cast<uint32_t>( address * 0x9e37'79b1U ) >> ( 32 - index_bits_ );
+  }
+
+  std::vector<Slot> slots_ {};
+  std::vector<uint8_t> next_victim_ {}; // per set: which way to evict next
+  unsigned index_bits_ {};
+  uint32_t generation_ { 1 };
+  uint64_t hits_ {};
+  uint64_t misses_ {};
+};
@@ -1,7 +1,17 @@
 #include "router.hh"
 #include "debug.hh"
+#include "spsc_ring.hh"
 
-#include <iostream>
+#include <array>
+#include <atomic>
+#include <barrier>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace std;
 
@@ -16,74 +26,270 @@ void Router::add_route( const uint32_t route_prefix,
                         const optional<Address> next_hop,
                         const size_t interface_num )
 {
-  Route entry{
-    .prefix = route_prefix,
-    .prefix_length = prefix_length,
+  // 出接口必须已经存在（否则要到转发时才会出错，并行模式下还是在工作线程里）
+  if ( interface_num >= interfaces_.size() ) {
+    throw runtime_error( "add_route: no interface " + to_string( interface_num ) );
+  }
+
+  const Route entry{
     .next_hop = next_hop,
     .interface_num = interface_num
   };
-  routing_table_.push_back(entry);
-  cerr << "DEBUG: adding route " << Address::from_ipv4_numeric( route_prefix ).ip() << "/"
-       << static_cast<int>( prefix_length ) << " => " << ( next_hop.has_value() ? next_hop->ip() : "(direct)" )
-       << " on interface " << interface_num << "\n";
+
+  // 同一前缀再次添加时覆盖原来的路由项
+  if ( const auto existing = prefix_table_.find( route_prefix, prefix_length ) ) {
+    routing_table_.at( *existing ) = entry;
+  } else {
+    routing_table_.push_back(entry);
+    prefix_table_.insert( route_prefix, prefix_length, static_cast<uint32_t>( routing_table_.size() - 1 ) );
+  }
+  route_cache_.invalidate();
+  routes_changed_ = true;
+
+  debug( "adding route {}/{} => {} on interface {}",
+         Address::from_ipv4_numeric( route_prefix ).ip(),
+         static_cast<int>( prefix_length ),
+         next_hop.has_value() ? next_hop->ip() : "(direct)",
+         interface_num );
 }
 
-// Go through all the interfaces, and route every incoming datagram to its proper outgoing interface.
-void Router::route()
+// An immutable copy of the routing table, shared with the worker threads of parallel mode
+struct Router::Snapshot
 {
-  // 遍历每个网络接口
-  for (auto& iface : interfaces_) {
-    auto& datagrams = iface->datagrams_received();
+  vector<Route> routes;
+  PrefixTable prefixes;
+  size_t cache_size; // of each worker's destination cache
+  uint64_t version;  // (a worker empties its cache when this changes)
+};
 
-    // 逐个处理收到的数据报
-    while (!datagrams.empty()) {
-      InternetDatagram dgram = datagrams.front();
-      datagrams.pop();
+// Parallel mode: one worker thread per interface. Each call of run() is one round, in two phases separated by a
+// barrier. First, every worker looks up the datagrams its own interface has received (in the latest published
+// Snapshot) and hands each one to the output interface's ring for datagrams from this worker. Then every worker
+// sends what is in its own interface's rings. So each NetworkInterface is only ever touched by its own worker. An
+// exception in a worker is kept (the worker still takes part in every phase), and rethrown by run().
+//
+// There is one SPSCRing per (input worker, output interface) pair. Only the producer touches a ring in the first
+// phase, and only the consumer in the second (the barrier between them hands it over), so a ring may grow until
+// it holds a round's worth of datagrams; from then on, handing a datagram over doesn't allocate.
+class Router::Workers
+{
+public:
+  explicit Workers( const vector<shared_ptr<NetworkInterface>>& interfaces )
+    : interfaces_( interfaces )
+    , errors_( interfaces.size() )
+    , barrier_( static_cast<ptrdiff_t>( interfaces.size() + 1 ) )
+  {
+    for ( size_t n = 0; n < interfaces_.size(); ++n ) {
+      outbound_.emplace_back( interfaces_.size() );
+    }
+    for ( size_t n = 0; n < interfaces_.size(); ++n ) {
+      threads_.emplace_back( [this, n] { work( n ); } );
+    }
+  }
 
-      const uint32_t dst_ip = dgram.header.dst;
+  ~Workers()
+  {
+    stopping_ = true;
+    barrier_.arrive_and_wait(); // (the threads are joined as threads_ is destroyed)
+  }
 
-      // 最长前缀匹配查找最佳路由项
-      Route* best_match = nullptr;
-      uint8_t longest_match = 0;
+  Workers( const Workers& ) = delete;
+  Workers& operator=( const Workers& ) = delete;
 
-      for (auto& entry : routing_table_) {
-        uint32_t mask = (entry.prefix_length == 0) ? 0 : (~0U << (32 - entry.prefix_length));
+  size_t size() const { return interfaces_.size(); }
 
-        if ((dst_ip & mask) == (entry.prefix & mask)) {
-          if (entry.prefix_length >= longest_match) {
-            longest_match = entry.prefix_length;
-            best_match = &entry;
-          }
-        }
+  void publish( shared_ptr<const Snapshot> snapshot ) { snapshot_.store( move( snapshot ) ); }
+
+  // Forward everything the interfaces have received, and wait for the workers to finish
+  void run()
+  {
+    barrier_.arrive_and_wait(); // start
+    barrier_.arrive_and_wait(); // every datagram is in an outbound queue
+    barrier_.arrive_and_wait(); // every datagram is sent
+
+    for ( auto& error : errors_ ) {
+      if ( error ) {
+        rethrow_exception( exchange( error, nullptr ) );
+      }
+    }
+  }
+
+private:
+  struct Forward
+  {
+    InternetDatagram dgram {};
+    uint32_t next_hop {};
+  };
+
+  void work( const size_t n )
+  {
+    NetworkInterface& iface = *interfaces_[n];
+    vector<InternetDatagram> batch;
+    RouteCache cache {}; // (a RouteCache can't be shared between threads)
+    optional<uint64_t> cache_version {};
+
+    while ( true ) {
+      barrier_.arrive_and_wait();
+      if ( stopping_ ) {
+        return;
       }
 
-      // 没有匹配项：丢包
-      if (best_match == nullptr) {
-        continue;
+      try {
+        const shared_ptr<const Snapshot> table = snapshot_.load();
+        if ( cache_version != table->version ) {
+          cache = RouteCache { table->cache_size };
+          cache_version = table->version;
+        }
+        while ( take_batch( iface.datagrams_received(), batch ) ) {
+          const auto hand_off = [&]( InternetDatagram& dgram, const Route& r ) {
+            const uint32_t next_hop = r.next_hop.has_value() ? r.next_hop->ipv4_numeric() : dgram.header.dst;
+            outbound_.at( r.interface_num )[n].push( { move( dgram ), next_hop } );
+          };
+          forward_batch( batch, table->routes, table->prefixes, cache, hand_off );
+        }
+      } catch ( ... ) {
+        errors_[n] = current_exception();
       }
+      barrier_.arrive_and_wait();
 
-      // TTL 检查
-      if (dgram.header.ttl <= 1) {
-        continue;
+      try {
+        for ( auto& ring : outbound_[n] ) {
+          while ( not ring.empty() ) {
+            Forward& forward = ring.front();
+            iface.send_datagram( move( forward.dgram ), Address::from_ipv4_numeric( forward.next_hop ) );
+            ring.pop();
+          }
+        }
+      } catch ( ... ) {
+        if ( not errors_[n] ) {
+          errors_[n] = current_exception();
+        }
       }
+      barrier_.arrive_and_wait();
+    }
+  }
+
+  vector<shared_ptr<NetworkInterface>> interfaces_;
+  vector<vector<SPSCRing<Forward>>> outbound_ {}; // [output interface][input worker]: datagrams to send
+  atomic<shared_ptr<const Snapshot>> snapshot_ {}; // the routes, as of the last publish()
+  vector<exception_ptr> errors_;                   // per worker: what it threw this round (if anything)
+  atomic<bool> stopping_ {};
+  barrier<> barrier_;
+  vector<jthread> threads_ {}; // (last, so that the threads are joined before anything else is destroyed)
+};
 
-      // TTL 减一
-      dgram.header.ttl--;
+Router::Router() = default;
+Router::~Router() = default;
 
-      //重新计算校验和
-      dgram.header.compute_checksum();
+void Router::set_parallel( const bool parallel )
+{
+  parallel_ = parallel;
+  if ( not parallel_ ) {
+    workers_.reset();
+  }
+}
+
+void Router::publish_routes()
+{
+  if ( workers_ ) {
+    workers_->publish( make_shared<const Snapshot>(
+      Snapshot { routing_table_, prefix_table_, route_cache_.size(), ++snapshot_version_ } ) );
+  }
+  routes_changed_ = false;
+}
+
+// Move up to ROUTE_BATCH_SIZE datagrams from `datagrams` into `batch`. Returns false if there were none.
+bool Router::take_batch( SPSCRing<InternetDatagram>& datagrams, vector<InternetDatagram>& batch )
+{
+  batch.clear();
+  while ( !datagrams.empty() && batch.size() < ROUTE_BATCH_SIZE ) {
+    batch.push_back( move( datagrams.front() ) );
+    datagrams.pop();
+  }
+  return !batch.empty();
+}
+
+// Look up a batch of datagrams, decrement their TTLs, and hand each one that should be forwarded (with its route)
+// to `forward`
+template<class Forward>
+void Router::forward_batch( vector<InternetDatagram>& batch,
+                            const vector<Route>& routes,
+                            const PrefixTable& prefixes,
+                            RouteCache& cache,
+                            Forward&& forward )
+{
+  array<optional<uint32_t>, ROUTE_BATCH_SIZE> route_indices {};
+  array<uint32_t, ROUTE_BATCH_SIZE> miss_destinations {};
+  array<size_t, ROUTE_BATCH_SIZE> miss_positions {};
+  array<optional<uint32_t>, ROUTE_BATCH_SIZE> miss_indices {};
+
+  // 先查目的地址缓存，未命中的再一起做最长前缀匹配（DIR-16-8-8 表，最多三次访存）
+  size_t misses = 0;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (!cache.find(batch[i].header.dst, route_indices[i])) {
+      miss_positions[misses] = i;
+      miss_destinations[misses++] = batch[i].header.dst;
+    }
+  }
+  prefixes.lookup_batch({miss_destinations.data(), misses}, miss_indices);
+  for (size_t j = 0; j < misses; ++j) {
+    route_indices[miss_positions[j]] = miss_indices[j];
+    cache.store(miss_destinations[j], miss_indices[j]);
+  }
 
-      // 计算下一跳地址：若是直连路由，用目标 IP；否则用指定的 next_hop
-      Address next_hop_ip = best_match->next_hop.value_or(Address::from_ipv4_numeric(dst_ip));
+  for (size_t i = 0; i < batch.size(); ++i) {
+    InternetDatagram& dgram = batch[i];
 
-      // 通过接口转发数据报 —— NetworkInterface 会自动处理 ARP 等细节
-      interface(best_match->interface_num)->send_datagram(dgram, next_hop_ip);
+    // 没有匹配项：丢包
+    if (!route_indices[i].has_value()) {
+      continue;
+    }
 
-      
+    // TTL 检查
+    if (dgram.header.ttl <= 1) {
+      continue;
     }
+
+    // TTL 减一，并增量更新校验和（RFC 1624），不必重新计算整个首部
+    dgram.header.decrement_ttl();
+
+    forward(dgram, routes[*route_indices[i]]);
   }
 }
 
+// Go through all the interfaces, and route every incoming datagram to its proper outgoing interface.
+void Router::route()
+{
+  if (parallel_) {
+    route_parallel();
+    return;
+  }
 
+  // 遍历每个网络接口；每次取出至多 ROUTE_BATCH_SIZE 个数据报，批量查表，让各自的访存延迟互相重叠
+  for (auto& iface : interfaces_) {
+    while (take_batch(iface->datagrams_received(), batch_)) {
+      forward_batch(batch_, routing_table_, prefix_table_, route_cache_,
+                    [&](InternetDatagram& dgram, const Route& r) {
+        // 计算下一跳地址：若是直连路由，用目标 IP；否则用指定的 next_hop
+        Address next_hop_ip = r.next_hop.value_or(Address::from_ipv4_numeric(dgram.header.dst));
 
+        // 通过接口转发数据报 —— NetworkInterface 会自动处理 ARP 等细节
+        interface(r.interface_num)->send_datagram(move(dgram), next_hop_ip);
+      });
+    }
+  }
+}
 
+void Router::route_parallel()
+{
+  // 接口数目变化（或第一次并行转发）时重建工作线程
+  if (not workers_ or workers_->size() != interfaces_.size()) {
+    workers_.reset();
+    workers_ = make_unique<Workers>(interfaces_);
+    routes_changed_ = true;
+  }
+  if (routes_changed_) {
+    publish_routes();
+  }
+  workers_->run();
+}
@@ -2,14 +2,21 @@
 
 #include "exception.hh"
 #include "network_interface.hh"
+#include "prefix_table.hh"
+#include "route_cache.hh"
 
+#include <memory>
 #include <optional>
+#include <queue>
 
 // \brief A router that has multiple network interfaces and
 // performs longest-prefix-match routing between them.
 class Router
 {
 public:
+  Router();
+  ~Router();
+
   // Add an interface to the router
   // \param[in] interface an already-constructed network interface
   // \returns The index of the interface after it has been added to the router
@@ -31,16 +38,60 @@ public:
   // Route packets between the interfaces
   void route();
 
+  // Put a destination cache of (about) `size` entries in front of the routing table; 0 turns it off
+  void set_route_cache_size( size_t size )
+  {
+    route_cache_ = RouteCache { size };
+    routes_changed_ = true; // (so that the workers of parallel mode get caches of the new size)
+  }
+
+  // The destination cache (e.g. for its hit and miss counters)
+  const RouteCache& route_cache() const { return route_cache_; }
+
+  // Forward with one worker thread per interface (true), or on the calling thread (false, the default). In
+  // parallel mode each worker keeps a destination cache of its own (of the same size), and route_cache() only
+  // counts the lookups made on the calling thread.
+  void set_parallel( bool parallel );
+
+  // Give the worker threads a copy of the routes added so far. (route() does this itself when routes have been
+  // added since; this is only needed to control when that copy is made.)
+  void publish_routes();
+
+  // Datagrams taken off an interface's queue at a time (and looked up together)
+  static constexpr size_t ROUTE_BATCH_SIZE = 32;
+
 private:
   // The router's collection of network interfaces
   std::vector<std::shared_ptr<NetworkInterface>> interfaces_ {};
   struct Route{
-    uint32_t prefix;
-    uint8_t prefix_length;
     optional<Address> next_hop;
     size_t interface_num; 
   };
 
   vector<Route> routing_table_{};  //路由表
+  PrefixTable prefix_table_ {};    // 前缀 => routing_table_ 下标（最长前缀匹配）
+
+  RouteCache route_cache_ {};      // 目的地址 => 查表结果（默认关闭），路由表变化时失效
+
+  vector<InternetDatagram> batch_ {}; // route() 正在处理的一批数据报（复用其容量）
+
+  // 并行转发：每个接口一个工作线程，路由表通过 Snapshot 指针发布给它们
+  struct Snapshot;
+  class Workers;
+  bool parallel_ {};
+  bool routes_changed_ {};            // 上次发布之后是否又添加了路由
+  uint64_t snapshot_version_ {};      // 已发布的 Snapshot 个数（工作线程据此清空各自的缓存）
+  std::unique_ptr<Workers> workers_ {};
+
+  void route_parallel();
+
+  static bool take_batch( SPSCRing<InternetDatagram>& datagrams, vector<InternetDatagram>& batch );
+
+  template<class Forward>
+  static void forward_batch( vector<InternetDatagram>& batch,
+                             const vector<Route>& routes,
+                             const PrefixTable& prefixes,
+                             RouteCache& cache,
+                             Forward&& forward );
 
 };
@@ -0,0 +1,139 @@
+#include "tcp_listener.hh"
+
+#include "helpers.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+
+using namespace std;
+
+TCPListener::TCPListener( const TCPConfig& cfg,
+                          const uint32_t local_ip,
+                          const uint16_t local_port,
+                          const size_t backlog )
+  : cfg_( cfg ), local_ip_( local_ip ), local_port_( local_port ), backlog_( backlog )
+{}
+
+//! \details Datagrams for an existing connection are delivered to its TCPPeer. A SYN (without RST) for an
+//! unknown connection creates a new connection in the SYN queue, unless the SYN queue or the accept queue is
+//! already full, in which case the SYN is dropped (the client will retransmit it). Anything else is ignored.
+void TCPListener::receive( InternetDatagram dgram, const TransmitFunction& transmit )
+{
+  // is the IPv4 datagram for us?
+  if ( dgram.header.proto != IPv4Header::PROTO_TCP or ( local_ip_ != 0 and dgram.header.dst != local_ip_ ) ) {
+    return;
+  }
+
+  TCPSegment seg;
+  if ( not parse( seg, move( dgram.payload ), dgram.header.pseudo_checksum() ) ) {
+    return;
+  }
+
+  if ( seg.udinfo.dst_port != local_port_ ) {
+    return;
+  }
+
+  const ConnectionKey key {
+    .remote_ip = dgram.header.src, .local_ip = dgram.header.dst, .remote_port = seg.udinfo.src_port };
+  auto it = connections_.find( key );
+
+  if ( it == connections_.end() ) {
+    if ( not seg.message.sender->SYN or seg.message.sender->RST ) {
+      return;
+    }
+
+    if ( syn_queue_size_ >= backlog_ or accept_queue_.size() >= backlog_ ) {
+      ++syns_dropped_;
+      return;
+    }
+
+    it = connections_
+           .emplace( key,
+                     make_shared<Connection>(
+                       cfg_, dgram.header.dst, local_port_, dgram.header.src, seg.udinfo.src_port ) )
+           .first;
+    ++syn_queue_size_;
+  }
+
+  const shared_ptr<Connection>& conn = it->second;
+  conn->peer_.receive( move( seg.message ),
+                       [&]( const TCPMessage& msg ) { transmit_from( *conn, msg, transmit ); } );
+
+  if ( conn->state_ == Connection::State::SynReceived ) {
+    maybe_enqueue( conn );
+  }
+}
+
+void TCPListener::push( const TransmitFunction& transmit )
+{
+  for ( auto& [key, conn] : connections_ ) {
+    if ( conn->state_ != Connection::State::SynReceived ) {
+      conn->peer_.push( [&]( const TCPMessage& msg ) { transmit_from( *conn, msg, transmit ); } );
+    }
+  }
+}
+
+//! \details Besides passing the time to every TCPPeer, this retries moving established connections into the
+//! accept queue, gives up on half-open connections after TCPConfig::MAX_RETX_ATTEMPTS retransmissions of the
+//! SYN-ACK, and forgets queued and accepted connections once they are no longer active.
+void TCPListener::tick( const uint64_t ms_since_last_tick, const TransmitFunction& transmit )
+{
+  for ( auto it = connections_.begin(); it != connections_.end(); ) {
+    const shared_ptr<Connection>& conn = it->second;
+    conn->peer_.tick( ms_since_last_tick,
+                      [&]( const TCPMessage& msg ) { transmit_from( *conn, msg, transmit ); } );
+
+    bool erase = false;
+    switch ( conn->state_ ) {
+      case Connection::State::SynReceived:
+        maybe_enqueue( conn );
+        if ( conn->state_ == Connection::State::SynReceived
+             and ( not conn->peer_.active()
+                   or conn->peer_.sender().consecutive_retransmissions() > TCPConfig::MAX_RETX_ATTEMPTS ) ) {
+          --syn_queue_size_;
+          erase = true;
+        }
+        break;
+      case Connection::State::Queued:
+        // (a connection that was reset or finished before the application accepted it gives up its place)
+        if ( not conn->peer_.active() ) {
+          erase_if( accept_queue_, [&]( const auto& queued ) { return queued == conn; } );
+          erase = true;
+        }
+        break;
+      case Connection::State::Accepted:
+        erase = not conn->peer_.active();
+        break;
+    }
+
+    it = erase ? connections_.erase( it ) : next( it );
+  }
+}
+
+shared_ptr<TCPListener::Connection> TCPListener::accept()
+{
+  if ( accept_queue_.empty() ) {
+    return nullptr;
+  }
+
+  auto conn = move( accept_queue_.front() );
+  accept_queue_.pop_front();
+  conn->state_ = Connection::State::Accepted;
+  return conn;
+}
+
+void TCPListener::transmit_from( const Connection& conn,
+                                 const TCPMessage& msg,
+                                 const TransmitFunction& transmit ) const
+{
+  const UserDatagramInfo ports { .src_port = conn.local_port_, .dst_port = conn.remote_port_, .cksum = 0 };
+  transmit( TCPOverIPv4Adapter::wrap_tcp_in_ip( msg, conn.local_ip_, conn.remote_ip_, ports ) );
+}
+
+void TCPListener::maybe_enqueue( const shared_ptr<Connection>& conn )
+{
+  if ( conn->established() and accept_queue_.size() < backlog_ ) {
+    conn->state_ = Connection::State::Queued;
+    --syn_queue_size_;
+    accept_queue_.push_back( conn );
+  }
+}
@@ -27,7 +27,7 @@ void TCPReceiver::receive( TCPSenderMessage message )
     //checkpoint(参考点的设置）：reassembler_.writer().bytes_pushed()表示当前写入输出流的字数
     //                       新接收到的序列号通常会接近这个位置 
     stream_index = message.seqno.unwrap(_isn, reassembler_.writer().bytes_pushed()) - 1;
-    cerr<<"stream_index: "<<stream_index<<"   data: "<<message.payload<<endl;
+    debug( "stream_index: {}   data: {}", stream_index, message.payload );
   }
   reassembler_.insert(stream_index, message.payload, message.FIN);
 }
@@ -41,12 +41,12 @@ TCPReceiverMessage TCPReceiver::send() const
       abs_ackno = 1;
       // 累加已经写入的字节数
       abs_ackno += reassembler_.writer().bytes_pushed();
-      cerr<<"abs_ackno: "<<reassembler_.writer().bytes_pushed()<<endl;
+      debug( "abs_ackno: {}", reassembler_.writer().bytes_pushed() );
   }
 
   // 若流关闭，说明收到了 FIN 标志，FIN 占一个序列号，abs_ackno 加 1
   if (reassembler_.writer().is_closed()) {
-    cerr<<"FIN"<<endl;
+    debug( "FIN" );
     abs_ackno += 1;
   }
   Wrap32 ackno = is_syn ? _isn + abs_ackno : Wrap32{0};
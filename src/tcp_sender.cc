@@ -2,6 +2,8 @@
 #include "debug.hh"
 #include "tcp_config.hh"
 #include <iostream>
+#include <iterator>
+#include <vector>
 using namespace std;
 
 // This function is for testing only; don't add extra state to support it.
@@ -22,11 +24,11 @@ void TCPSender::push(const TransmitFunction& transmit)
   // 首先检查Writer是否存在错误并设置错误状态，有错误的话停止push，并返回空的message
   if (writer().has_error()) {
     _has_error = true;
-    cerr << "DEBUG: writer has error, setting _has_error = true" << endl;
+    debug( "writer has error, setting _has_error = true" );
   }
 
   if (_has_error) {
-    cerr << "DEBUG: _has_error is true in push(), sending RST message" << endl;
+    debug( "_has_error is true in push(), sending RST message" );
     TCPSenderMessage rst_msg = make_empty_message();
     transmit(rst_msg);
     return;
@@ -55,8 +57,13 @@ void TCPSender::push(const TransmitFunction& transmit)
       remaining_window = remaining_window > 0 ? remaining_window - 1 : 0;
     }
     
+    // PLPMTUD：窗口和待发送的数据都够的话，这一段作为探测报文段，比平时更大
+    const size_t probe_size = msg.SYN ? 0 : next_probe_size();
+    const bool is_probe = probe_size > 0 && remaining_window >= probe_size &&
+                          writer().reader().bytes_buffered() >= probe_size;
+
     // 计算可以发送的数据大小
-    size_t payload_size = min(remaining_window, TCPConfig::MAX_PAYLOAD_SIZE);
+    size_t payload_size = min(remaining_window, is_probe ? probe_size : max_payload_size_);
     payload_size = min(payload_size, writer().reader().bytes_buffered());
     
     // 读取数据
@@ -75,9 +82,19 @@ void TCPSender::push(const TransmitFunction& transmit)
     outstanding_collections.push_back(msg);
     outstanding_bytes += msg.sequence_length();  // 确保正确计算序列号占用
     abs_seqno += msg.sequence_length();
+    if (is_probe) {
+      plpmtud_->probe_size = probe_size;
+      plpmtud_->probe_end = abs_seqno;
+    }
     
     // 立即发送创建的消息
     transmit(msg);
+    count_sent(msg, false);
+    // 没有正在测 RTT 的报文段的话，测这一个
+    if (!rtt_timed_end_) {
+      rtt_timed_end_ = abs_seqno;
+      rtt_timed_at_ = time_ms_;
+    }
     
     // 如果有未确认的数据，启动计时器
     if (outstanding_bytes > 0 && !is_start_timer) {
@@ -94,8 +111,7 @@ TCPSenderMessage TCPSender::make_empty_message() const
   
   // 检查是否有错误，无论是来自内部标志还是Writer
   bool has_error = _has_error || writer().has_error();
-  cerr << "DEBUG: make_empty_message called, _has_error = " << (_has_error ? "true" : "false") 
-       << ", writer().has_error() = " << (writer().has_error() ? "true" : "false") << endl;
+  debug( "make_empty_message called, _has_error = {}, writer().has_error() = {}", _has_error, writer().has_error() );
   
   if (has_error) {
     msg.RST = true;
@@ -104,7 +120,7 @@ TCPSenderMessage TCPSender::make_empty_message() const
   return msg;
 }
 
-void TCPSender::receive(const TCPReceiverMessage& msg)
+void TCPSender::receive(const TCPReceiverMessage& msg, bool carried_data)
 {
   // 检查收到的RST标志
   if (msg.RST) {
@@ -118,15 +134,33 @@ void TCPSender::receive(const TCPReceiverMessage& msg)
     return;  // 如果有错误，不执行任何操作
   }
   
+  // 不带数据（也不带 SYN、FIN），确认号和窗口都没变，而且还有未确认的数据：重复的 ACK（RFC 5681）
+  if (!carried_data && msg.ackno.has_value() && msg.ackno == received_msg.ackno &&
+      msg.window_size == received_msg.window_size && outstanding_bytes > 0) {
+    stats_.dup_acks++;
+  }
+
   received_msg = msg;
   primitive_window_size = msg.window_size;
   if (msg.ackno.has_value() == true) {
     uint64_t ackno_unwrapped = static_cast<uint64_t>(msg.ackno.value().unwrap(isn_, abs_seqno));
     if (ackno_unwrapped > abs_seqno) return;
+    if (rtt_timed_end_ && ackno_unwrapped >= *rtt_timed_end_) {
+      add_rtt_sample(time_ms_ - rtt_timed_at_);
+      rtt_timed_end_.reset();
+    }
+    // 探测报文段被确认了：路径装得下这么大的报文段，以后都用这个大小
+    if (plpmtud_ && plpmtud_->probe_end.has_value() && ackno_unwrapped >= *plpmtud_->probe_end) {
+      max_payload_size_ = plpmtud_->probe_size;
+      plpmtud_->probe_end.reset();
+      plpmtud_->probe_failures = 0;
+      check_search_done();
+    }
     while (outstanding_bytes != 0 && 
            static_cast<uint64_t>(outstanding_collections.front().seqno.unwrap(isn_, abs_seqno)) + 
            outstanding_collections.front().sequence_length() <= ackno_unwrapped) {
       outstanding_bytes -= outstanding_collections.front().sequence_length();
+      stats_.bytes_acked += outstanding_collections.front().payload.size();
       outstanding_collections.pop_front();
       consecutive_retransmissions_nums = 0;
       cur_RTO_ms = initial_RTO_ms_;
@@ -142,11 +176,56 @@ void TCPSender::tick(uint64_t ms_since_last_tick, const TransmitFunction& transm
     return;  // 如果有错误，不执行任何操作
   }
   
+  time_ms_ += ms_since_last_tick;
+
+  // 这段时间发送方受什么限制：窗口（有数据要发但窗口满了），还是应用（数据都发完了，流还没关）
+  if (isSent_ISN) {
+    const uint64_t window = received_msg.window_size ? received_msg.window_size : 1;
+    const bool more_to_send = reader().bytes_buffered() > 0 || (writer().is_closed() && !isSent_FIN);
+    if (more_to_send && outstanding_bytes >= window) {
+      stats_.window_limited_ms += ms_since_last_tick;
+    } else if (!more_to_send && !writer().is_closed()) {
+      stats_.app_limited_ms += ms_since_last_tick;
+    }
+  }
+
   // 只有当有未确认的数据且计时器启动时才减少时间
   if (is_start_timer) {
     if (cur_RTO_ms <= ms_since_last_tick) {
-      // 超时，重传第一个未确认的段
-      transmit(outstanding_collections.front());
+      const TCPSenderMessage& front = outstanding_collections.front();
+      const uint64_t front_end = front.seqno.unwrap(isn_, abs_seqno) + front.sequence_length();
+
+      // 超时的是探测报文段：说明路径装不下这么大的报文段，而不是拥塞。
+      // 按原来的大小拆开重传，不计入连续重传次数，也不退避
+      if (plpmtud_ && plpmtud_->probe_end == front_end) {
+        plpmtud_->probe_end.reset();
+        if (++plpmtud_->probe_failures >= PLPMTUD_MAX_PROBES) {
+          plpmtud_->search_high = plpmtud_->probe_size - 1;
+          plpmtud_->probe_failures = 0;
+          check_search_done();
+        }
+        split_and_retransmit_front(transmit);
+        cur_RTO_ms = initial_RTO_ms_;
+        return;
+      }
+
+      // 之前可行的大小连续超时：路径可能变小了（“黑洞”），退回到一定可行的大小，重新搜索
+      if (plpmtud_ && consecutive_retransmissions_nums + 1 >= PLPMTUD_BLACK_HOLE_RETX &&
+          front.payload.size() > plpmtud_->base_payload_size) {
+        plpmtud_->search_high = min(plpmtud_->search_high, front.payload.size() - 1);
+        max_payload_size_ = plpmtud_->base_payload_size;
+        plpmtud_->probe_end.reset();
+        plpmtud_->probe_failures = 0;
+        check_search_done();
+      }
+
+      // 超时，重传第一个未确认的段（比现在的最大负载大的话，拆开重传）
+      if (plpmtud_ && front.payload.size() > max_payload_size_) {
+        split_and_retransmit_front(transmit);
+      } else {
+        transmit(front);
+        count_sent(front, true);
+      }
       consecutive_retransmissions_nums++;
       // 有空间的话指数退避
       if (primitive_window_size) 
@@ -160,4 +239,100 @@ void TCPSender::tick(uint64_t ms_since_last_tick, const TransmitFunction& transm
       cur_RTO_ms -= ms_since_last_tick;
     }
   }
-}
\ No newline at end of file
+}
+
+void TCPSender::enable_plpmtud(size_t max_probe_payload_size, size_t initial_payload_size)
+{
+  plpmtud_ = PLPMTUD { .base_payload_size = max_payload_size_,
+                       .max_probe_payload_size = max_probe_payload_size,
+                       .search_high = max_probe_payload_size };
+
+  // 已知（比如缓存的）可行的大小：直接使用，等下一轮再搜索更大的
+  if (initial_payload_size > max_payload_size_) {
+    max_payload_size_ = min(initial_payload_size, max_probe_payload_size);
+    plpmtud_->search_high = max_payload_size_;
+  }
+  check_search_done();
+}
+
+size_t TCPSender::next_probe_size()
+{
+  if (!plpmtud_ || plpmtud_->probe_end.has_value()) return 0;
+
+  PLPMTUD& plpmtud = *plpmtud_;
+  if (plpmtud.search_high < max_payload_size_ + PLPMTUD_SEARCH_DONE) {
+    if (time_ms_ < plpmtud.raise_at) return 0;
+    // 过了足够久，重新从上限开始搜索
+    plpmtud.search_high = plpmtud.max_probe_payload_size;
+    plpmtud.probe_failures = 0;
+    check_search_done();
+    if (plpmtud.search_high < max_payload_size_ + PLPMTUD_SEARCH_DONE) return 0;
+  }
+
+  // 二分：取已知可行的大小和上界的中点
+  return (max_payload_size_ + plpmtud.search_high + 1) / 2;
+}
+
+void TCPSender::check_search_done()
+{
+  if (plpmtud_->search_high < max_payload_size_ + PLPMTUD_SEARCH_DONE) {
+    plpmtud_->raise_at = time_ms_ + PLPMTUD_RAISE_MS;
+  }
+}
+
+void TCPSender::split_and_retransmit_front(const TransmitFunction& transmit)
+{
+  const TCPSenderMessage front = std::move(outstanding_collections.front());
+  outstanding_collections.pop_front();
+
+  // SYN 留在第一段，FIN 放到最后一段；序列号总数不变，所以 outstanding_bytes 也不变
+  std::vector<TCPSenderMessage> pieces;
+  for (size_t pos = 0; pos < front.payload.size() || pieces.empty(); pos += max_payload_size_) {
+    TCPSenderMessage piece;
+    piece.SYN = front.SYN && pos == 0;
+    piece.seqno = front.seqno + static_cast<uint32_t>(pos + (front.SYN && pos > 0));
+    piece.payload = front.payload.substr(pos, max_payload_size_);
+    piece.FIN = front.FIN && pos + max_payload_size_ >= front.payload.size();
+    pieces.push_back(std::move(piece));
+  }
+
+  outstanding_collections.insert(outstanding_collections.begin(),
+                                 std::make_move_iterator(pieces.begin()),
+                                 std::make_move_iterator(pieces.end()));
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    transmit(outstanding_collections[i]);
+    count_sent(outstanding_collections[i], true);
+  }
+}
+
+uint64_t TCPSender::rto_ms() const
+{
+  // 和 tick() 里一样：窗口不为 0 时按连续重传次数指数退避
+  return primitive_window_size ? (1UL << consecutive_retransmissions_nums) * initial_RTO_ms_ : initial_RTO_ms_;
+}
+
+void TCPSender::count_sent(const TCPSenderMessage& msg, bool retransmission)
+{
+  stats_.segments_sent++;
+  stats_.bytes_sent += msg.payload.size();
+  if (retransmission) {
+    stats_.retransmissions++;
+    stats_.bytes_retransmitted += msg.payload.size();
+    // Karn 算法：重传之后收到的 ACK 分不清是对哪一次的，不能用来测 RTT
+    rtt_timed_end_.reset();
+  }
+}
+
+void TCPSender::add_rtt_sample(uint64_t rtt_ms)
+{
+  // RFC 6298 第 2 节：alpha = 1/8，beta = 1/4（样本是整毫秒，换成微秒再平滑）
+  const uint64_t rtt_us = rtt_ms * 1000;
+  if (stats_.rtt_samples++ == 0) {
+    stats_.srtt_us = rtt_us;
+    stats_.rttvar_us = rtt_us / 2;
+  } else {
+    const uint64_t deviation = stats_.srtt_us > rtt_us ? stats_.srtt_us - rtt_us : rtt_us - stats_.srtt_us;
+    stats_.rttvar_us = (3 * stats_.rttvar_us + deviation) / 4;
+    stats_.srtt_us = (7 * stats_.srtt_us + rtt_us) / 8;
+  }
+}
@@ -1,11 +1,13 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 #include "deque"
 
 #include <functional>
+#include <optional>
 
 class TCPSender
 {
@@ -33,8 +35,9 @@ class TCPSender
   /* Generate an empty TCPSenderMessage */
   TCPSenderMessage make_empty_message() const;
 
-  /* Receive and process a TCPReceiverMessage from the peer's receiver */
-  void receive( const TCPReceiverMessage& msg );
+  /* Receive and process a TCPReceiverMessage from the peer's receiver. `carried_data` says whether the segment
+     it arrived on also occupied sequence numbers (data, SYN or FIN); such an ACK is never a duplicate ACK. */
+  void receive( const TCPReceiverMessage& msg, bool carried_data = false );
 
   /* Type of the `transmit` function that the push and tick methods can use to send messages */
   using TransmitFunction = std::function<void( const TCPSenderMessage& )>;
@@ -54,7 +57,47 @@ class TCPSender
   Reader& reader() { return input_.reader(); }
   
   void set_error() { _has_error = true; }
+
+  /* Largest payload to put in one segment (TCPConfig::MAX_PAYLOAD_SIZE unless the link can segment for us) */
+  void set_max_payload_size( size_t max_payload_size ) { max_payload_size_ = max_payload_size; }
+  size_t max_payload_size() const { return max_payload_size_; }
   bool has_error() const { return _has_error; }
+
+  /* Packetization-layer path MTU discovery (RFC 4821): now and then, send one segment larger than the max
+     payload size as a probe. If it is acknowledged, use that size from then on; if it is lost, resend its bytes
+     in segments of the old size (without backing off, as the loss says nothing about congestion), and after
+     PLPMTUD_MAX_PROBES losses stop searching above it. The search halves the range between the largest size
+     known to fit the path and the smallest known not to, starting from max_probe_payload_size. If segments of
+     a size that worked keep timing out (the path changed), fall back to the original max payload size. The
+     current max payload size becomes the smallest size known to fit, or `initial_payload_size` if larger. */
+  void enable_plpmtud( size_t max_probe_payload_size, size_t initial_payload_size = 0 );
+  bool plpmtud_enabled() const { return plpmtud_.has_value(); }
+
+  /* Counters for TCPPeer::stats(): plain integers, cheap enough to keep on all the time */
+  struct Stats
+  {
+    uint64_t segments_sent = 0;       // 占用序列号的报文段（含重传）
+    uint64_t bytes_sent = 0;          // 发送的负载字节（含重传）
+    uint64_t retransmissions = 0;     // 重传的报文段
+    uint64_t bytes_retransmitted = 0; // 重传的负载字节
+    uint64_t bytes_acked = 0;         // 被确认的负载字节
+    uint64_t dup_acks = 0;            // 重复的 ACK（RFC 5681）：不带数据、SYN、FIN，确认号和窗口都没变，还有未确认的数据
+    uint64_t rtt_samples = 0;         // RTT 的样本数（按 Karn 算法，不测重传过的报文段）
+    uint64_t srtt_us = 0;             // 平滑的 RTT（RFC 6298）
+    uint64_t rttvar_us = 0;           // RTT 的平均偏差
+    // （注意：RTT 样本只精确到 1 ms，因为时钟就是 tick() 的毫秒数；用微秒存放只是为了平滑时不丢掉零头）
+    uint64_t window_limited_ms = 0;   // 有数据要发，但窗口已满的时间
+    uint64_t app_limited_ms = 0;      // 数据都发完了，在等应用写入的时间
+  };
+  const Stats& stats() const { return stats_; }
+
+  uint64_t window_size() const { return received_msg.window_size; } // 对方通告的窗口
+  uint64_t rto_ms() const;                                           // 当前的重传超时（含退避）
+
+  static constexpr unsigned PLPMTUD_MAX_PROBES = 3;      // 同一大小的探测最多丢几次
+  static constexpr size_t PLPMTUD_SEARCH_DONE = 16;       // 上下界相差不到这么多字节时，搜索结束
+  static constexpr uint64_t PLPMTUD_RAISE_MS = 600000;    // 搜索结束后，隔多久再试更大的（路径可能变了）
+  static constexpr unsigned PLPMTUD_BLACK_HOLE_RETX = 2; // 连续重传几次后，认为路径变小了
   
   private:
   ByteStream input_;
@@ -71,4 +114,35 @@ class TCPSender
   uint64_t outstanding_bytes;  //需要重传的消息所占的字节
   uint64_t consecutive_retransmissions_nums;  //连续重传次数
   bool _has_error = false;   //错误判别
+  size_t max_payload_size_ = TCPConfig::MAX_PAYLOAD_SIZE;  //单个报文段的最大负载
+  uint64_t time_ms_ = 0;  //累计经过的时间
+
+  // 统计
+  Stats stats_ {};
+  std::optional<uint64_t> rtt_timed_end_ {}; // 正在测 RTT 的报文段之后的绝对序列号
+  uint64_t rtt_timed_at_ = 0;                // 它是什么时候发出的
+  // 记一个发出的报文段
+  void count_sent(const TCPSenderMessage& msg, bool retransmission);
+  // 用一个 RTT 样本更新 srtt 和 rttvar
+  void add_rtt_sample(uint64_t rtt_ms);
+
+  // PLPMTUD 的状态
+  struct PLPMTUD
+  {
+    size_t base_payload_size;             // 一定可行的负载大小（黑洞时退回到这里）
+    size_t max_probe_payload_size;        // 配置的探测上限
+    size_t search_high;                   // 比它大的都不行（或超过上限）
+    size_t probe_size = 0;                // 在途探测报文段的负载大小
+    std::optional<uint64_t> probe_end {}; // 在途探测报文段之后的绝对序列号
+    unsigned probe_failures = 0;          // 这个大小的探测丢了几次
+    uint64_t raise_at = 0;                // 搜索结束后，什么时候重新开始
+  };
+  std::optional<PLPMTUD> plpmtud_ {};
+
+  // 现在该发的探测报文段的负载大小（0 表示不该探测）
+  size_t next_probe_size();
+  // 上下界足够接近时，结束搜索并定好什么时候重新开始
+  void check_search_done();
+  // 把最早的未确认报文段拆成不超过 max_payload_size_ 的几段，并全部重传
+  void split_and_retransmit_front( const TransmitFunction& transmit );
 };
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// \brief A hashed timing wheel: a ring of slots, each collecting the timers due within one `resolution`-ms tick.
+//
+// schedule() is O(1), and advance() only visits the slots for the ticks that the clock has passed (plus the
+// timers in them that belong to a later revolution, which are kept). Timers can't be cancelled; the owner should
+// check, when one fires, whether it still means anything (e.g. by comparing its deadline with the current one).
+template<class Key>
+class TimerWheel
+{
+public:
+  TimerWheel( uint64_t resolution_ms, size_t num_slots ) : slots_( num_slots ), resolution_( resolution_ms ) {}
+
+  // Call fire( key, deadline ) once `deadline` has been reached
+  void schedule( uint64_t deadline, const Key& key )
+  {
+    const uint64_t tick = ( deadline > now_ ? deadline : now_ ) / resolution_;
+    slots_[tick % slots_.size()].push_back( { deadline, key } );
+  }
+
+  // Move the clock to `now`, and call fire( key, deadline ) for every timer that has become due. (`fire` may
+  // schedule more timers.)
+  template<class Fire>
+  void advance( uint64_t now, Fire&& fire )
+  {
+    const uint64_t first_tick = now_ / resolution_;
+    const uint64_t last_tick = now / resolution_;
+    now_ = now;
+
+    // (after a long jump, every slot needs looking at, but only once)
+    const uint64_t num_ticks = last_tick - first_tick + 1 < slots_.size() ? last_tick - first_tick + 1 : slots_.size();
+
+    due_.clear();
+    for ( uint64_t tick = first_tick; tick < first_tick + num_ticks; ++tick ) {
+      auto& slot = slots_[tick % slots_.size()];
+      for ( size_t i = 0; i < slot.size(); ) {
+        if ( slot[i].deadline <= now ) {
+          due_.push_back( slot[i] );
+          slot[i] = slot.back();
+          slot.pop_back();
+        } else {
+          ++i;
+        }
+      }
+    }
+
+    for ( const Timer& timer : due_ ) {
+      fire( timer.key, timer.deadline );
+    }
+  }
+
+  size_t size() const
+  {
+    size_t ret = 0;
+    for ( const auto& slot : slots_ ) {
+      ret += slot.size();
+    }
+    return ret;
+  }
+
+private:
+  struct Timer
+  {
+    uint64_t deadline;
+    Key key;
+  };
+
+  std::vector<std::vector<Timer>> slots_;
+  uint64_t resolution_;
+  uint64_t now_ {};
+  std::vector<Timer> due_ {}; // (reused by advance)
+};
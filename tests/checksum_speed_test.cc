@@ -0,0 +1,135 @@
+#include "checksum.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+// The original byte-at-a-time algorithm, to check the fast one against
+class ReferenceChecksum
+{
+  uint32_t sum_ {};
+  bool parity_ {};
+
+public:
+  void add( string_view data )
+  {
+    for ( const uint8_t i : data ) {
+      uint16_t val = i;
+      if ( not parity_ ) {
+        val <<= 8;
+      }
+      sum_ += val;
+      parity_ = !parity_;
+    }
+  }
+
+  uint16_t value() const
+  {
+    uint32_t ret = sum_;
+    while ( ret > 0xffff ) {
+      ret = ( ret >> 16 ) + static_cast<uint16_t>( ret );
+    }
+    return ~ret;
+  }
+};
+
+string random_string( default_random_engine& rd, size_t len )
+{
+  uniform_int_distribution<char> ud;
+  string ret;
+  for ( size_t i = 0; i < len; ++i ) {
+    ret += ud( rd );
+  }
+  return ret;
+}
+
+// Split random buffers at random (often odd) offsets, and check that both algorithms agree
+void correctness_test()
+{
+  default_random_engine rd { 1071 };
+  for ( size_t trial = 0; trial < 10000; ++trial ) {
+    const string data = random_string( rd, uniform_int_distribution<size_t> { 0, 3000 }( rd ) );
+
+    InternetChecksum fast { static_cast<uint32_t>( trial ) };
+    ReferenceChecksum reference;
+    reference.add( string { static_cast<char>( trial >> 8 ), static_cast<char>( trial ) } );
+
+    size_t offset = 0;
+    while ( offset < data.size() ) {
+      const size_t len = min( data.size() - offset, uniform_int_distribution<size_t> { 0, 100 }( rd ) );
+      const string_view chunk { data.data() + offset, len };
+      fast.add( chunk );
+      reference.add( chunk );
+      offset += len;
+    }
+
+    if ( fast.value() != reference.value() ) {
+      throw runtime_error( "checksum mismatch for " + to_string( data.size() ) + "-byte buffer" );
+    }
+  }
+}
+
+void speed_test( fstream& debug_output, const size_t chunk_size, const size_t chunk_offset )
+{
+  constexpr size_t TOTAL_BYTES = 1UL << 30;
+
+  default_random_engine rd { chunk_size };
+  const string storage = random_string( rd, chunk_size + chunk_offset );
+  const string_view chunk { storage.data() + chunk_offset, chunk_size };
+
+  uint16_t sink = 0;
+  const auto start_time = steady_clock::now();
+  for ( size_t total = 0; total < TOTAL_BYTES; total += chunk_size ) {
+    InternetChecksum check { sink };
+    check.add( chunk );
+    sink = check.value();
+  }
+  const auto stop_time = steady_clock::now();
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const auto gigabits_per_second = TOTAL_BYTES * 8.0 / test_duration.count() / 1e9;
+
+  cout << "InternetChecksum of " << chunk_size << "-byte chunks (offset " << chunk_offset << ") at " << fixed
+       << setprecision( 2 ) << gigabits_per_second << " Gbit/s (check " << sink << ")\n";
+
+  debug_output << "         InternetChecksum (" << setw( 5 ) << chunk_size << " bytes, offset " << chunk_offset
+               << "): " << fixed << setprecision( 2 ) << setw( 6 ) << gigabits_per_second << " Gbit/s\n";
+
+  if ( gigabits_per_second < 10 ) {
+    throw runtime_error( "InternetChecksum did not meet minimum speed of 10 Gbit/s" );
+  }
+}
+
+void program_body()
+{
+  correctness_test();
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  speed_test( debug_output, 1460, 0 );
+  speed_test( debug_output, 1461, 1 );
+  speed_test( debug_output, 65495, 0 );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
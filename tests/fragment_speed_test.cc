@@ -0,0 +1,228 @@
+#include "arp_message.hh"
+#include "fragment_reassembler.hh"
+#include "helpers.hh"
+#include "network_interface.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+constexpr size_t NUM_DATAGRAMS = 20'000;
+constexpr size_t MTU = 576;
+
+const EthernetAddress LOCAL_ETH { 2, 0, 0, 0, 0, 1 };
+const EthernetAddress REMOTE_ETH { 2, 0, 0, 0, 0, 2 };
+const Address LOCAL_IP { "10.0.0.1" };
+const Address REMOTE_IP { "10.0.0.2" };
+
+bool checksum_ok( const IPv4Header& header )
+{
+  IPv4Header copy = header;
+  copy.compute_checksum();
+  return copy.cksum == header.cksum;
+}
+
+// An output port that keeps the IPv4 datagrams (here: fragments) it is given
+class CapturingPort : public NetworkInterface::OutputPort
+{
+public:
+  vector<InternetDatagram> fragments {};
+  void transmit( const NetworkInterface& /* sender */, const EthernetFrame& frame ) override
+  {
+    if ( frame.header.type != EthernetHeader::TYPE_IPv4 ) {
+      return;
+    }
+    InternetDatagram fragment;
+    if ( not parse( fragment, clone( frame ).payload ) ) {
+      throw runtime_error( "NetworkInterface sent a fragment that doesn't parse" );
+    }
+    fragments.push_back( move( fragment ) );
+  }
+};
+
+// Datagrams of random sizes (up to ten fragments each) and contents, from a few sources
+vector<InternetDatagram> make_datagrams( default_random_engine& rd )
+{
+  uniform_int_distribution<size_t> size_dist { 600, 5500 };
+  uniform_int_distribution<char> byte_dist;
+  vector<InternetDatagram> datagrams;
+  datagrams.reserve( NUM_DATAGRAMS );
+  for ( size_t i = 0; i < NUM_DATAGRAMS; ++i ) {
+    string payload( size_dist( rd ), 0 );
+    for ( auto& ch : payload ) {
+      ch = byte_dist( rd );
+    }
+    InternetDatagram dgram;
+    dgram.header.src = 0x0a000100 + static_cast<uint32_t>( i % 16 );
+    dgram.header.dst = REMOTE_IP.ipv4_numeric();
+    dgram.header.id = static_cast<uint16_t>( i / 16 );
+    dgram.header.df = false;
+    dgram.header.len = static_cast<uint16_t>( IPv4Header::LENGTH + payload.size() );
+    dgram.header.compute_checksum();
+    dgram.payload.emplace_back( move( payload ) );
+    datagrams.push_back( move( dgram ) );
+  }
+  return datagrams;
+}
+
+// Fragment the datagrams with a NetworkInterface, and return the fragments (in the order they were sent)
+vector<InternetDatagram> fragment( const vector<InternetDatagram>& datagrams, fstream& debug_output )
+{
+  auto port = make_shared<CapturingPort>();
+  NetworkInterface iface { "eth0", port, LOCAL_ETH, LOCAL_IP };
+  iface.set_mtu( MTU );
+
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = REMOTE_ETH;
+  arp.sender_ip_address = REMOTE_IP.ipv4_numeric();
+  arp.target_ethernet_address = LOCAL_ETH;
+  arp.target_ip_address = LOCAL_IP.ipv4_numeric();
+  iface.recv_frame(
+    { .header = { .dst = LOCAL_ETH, .src = REMOTE_ETH, .type = EthernetHeader::TYPE_ARP },
+      .payload = serialize( arp ) } );
+
+  port->fragments.reserve( NUM_DATAGRAMS * 10 );
+  const auto start_time = steady_clock::now();
+  for ( const auto& dgram : datagrams ) {
+    iface.send_datagram( dgram, REMOTE_IP );
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( iface.fragment_stats().datagrams_fragmented != datagrams.size()
+       or iface.fragment_stats().fragments_sent != port->fragments.size() ) {
+    throw runtime_error( "NetworkInterface did not fragment every datagram" );
+  }
+  for ( const auto& fragment : port->fragments ) {
+    if ( fragment.header.len > MTU or not checksum_ok( fragment.header ) ) {
+      throw runtime_error( "NetworkInterface sent a bad fragment: " + fragment.header.to_string() );
+    }
+  }
+
+  const double seconds = duration_cast<duration<double>>( stop_time - start_time ).count();
+  cout << "NetworkInterface fragmentation (MTU " << MTU << ", including parsing) reached " << fixed
+       << setprecision( 2 ) << static_cast<double>( port->fragments.size() ) / seconds / 1e6
+       << " M fragments/s.\n";
+  debug_output << "     Fragmentation (incl. parsing): " << fixed << setprecision( 2 ) << setw( 6 )
+               << static_cast<double>( port->fragments.size() ) / seconds / 1e6 << " M fragments/s\n";
+  return move( port->fragments );
+}
+
+// Reassemble the fragments with `window` datagrams in flight at a time, whose fragments (plus a duplicate of
+// every eighth one) arrive shuffled together
+void reassembly_test( const vector<InternetDatagram>& datagrams,
+                      const vector<InternetDatagram>& fragments,
+                      const size_t window,
+                      default_random_engine& rd,
+                      fstream& debug_output )
+{
+  vector<InternetDatagram> arrivals;
+  arrivals.reserve( fragments.size() * 9 / 8 + 1 );
+  auto next = fragments.begin();
+  for ( size_t first = 0; first < datagrams.size(); first += window ) {
+    const auto window_start = arrivals.size();
+    const size_t last = min( first + window, datagrams.size() );
+    size_t datagrams_done = first;
+    while ( datagrams_done < last ) {
+      arrivals.push_back( clone( *next ) );
+      if ( arrivals.size() % 8 == 0 ) {
+        arrivals.push_back( clone( *next ) );
+      }
+      if ( not next->header.mf ) {
+        ++datagrams_done;
+      }
+      ++next;
+    }
+    shuffle( arrivals.begin() + static_cast<ptrdiff_t>( window_start ), arrivals.end(), rd );
+  }
+
+  // a fragment arrives every 10 us, and a datagram is given up on after 100 ms (so that the incomplete datagrams
+  // started by late duplicates time out rather than fill the reassembler)
+  FragmentReassembler reassembler { { .max_bytes = 16 * 1024 * 1024, .max_datagrams = 4096, .timeout_ms = 100 } };
+  vector<InternetDatagram> reassembled;
+  reassembled.reserve( datagrams.size() );
+  uint64_t bytes = 0;
+
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < arrivals.size(); ++i ) {
+    bytes += arrivals[i].header.len - IPv4Header::LENGTH;
+    reassembler.expire( i / 100 );
+    auto whole = reassembler.insert( move( arrivals[i] ), i / 100 );
+    if ( whole.has_value() ) {
+      reassembled.push_back( move( *whole ) );
+    }
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( reassembled.size() != datagrams.size() or reassembler.stats().evicted != 0
+       or reassembler.stats().malformed != 0 ) {
+    throw runtime_error( "FragmentReassembler reassembled " + to_string( reassembled.size() ) + " of "
+                         + to_string( datagrams.size() ) + " datagrams" );
+  }
+
+  reassembler.expire( arrivals.size() / 100 + 100 );
+  if ( reassembler.size() != 0 or reassembler.bytes() != 0 ) {
+    throw runtime_error( "FragmentReassembler kept " + to_string( reassembler.bytes() ) + " bytes" );
+  }
+
+  // datagrams are completed in a different order, but all of them exactly once
+  const auto key = []( const InternetDatagram& dgram ) { return dgram.header.id * 16 + ( dgram.header.src & 15 ); };
+  for ( const auto& whole : reassembled ) {
+    const auto& original = datagrams.at( key( whole ) );
+    if ( whole.header.len != original.header.len or not checksum_ok( whole.header )
+         or concat( whole.payload ) != concat( original.payload ) ) {
+      throw runtime_error( "FragmentReassembler produced the wrong datagram: " + whole.header.to_string() );
+    }
+  }
+
+  const double seconds = duration_cast<duration<double>>( stop_time - start_time ).count();
+  const double gigabits_per_second = static_cast<double>( bytes ) * 8 / seconds / 1e9;
+  cout << "FragmentReassembler with " << window << " interleaved datagrams reached " << fixed
+       << setprecision( 2 ) << static_cast<double>( arrivals.size() ) / seconds / 1e6 << " M fragments/s, "
+       << gigabits_per_second << " Gbit/s.\n";
+  debug_output << "     Reassembly (" << setw( 4 ) << window << " interleaved): " << fixed << setprecision( 2 )
+               << setw( 6 ) << static_cast<double>( arrivals.size() ) / seconds / 1e6 << " M fragments/s, "
+               << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
+
+  if ( gigabits_per_second < 0.1 ) {
+    throw runtime_error( "FragmentReassembler did not meet minimum speed of 0.1 Gbit/s." );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  default_random_engine rd { 4246 };
+  const vector<InternetDatagram> datagrams = make_datagrams( rd );
+  const vector<InternetDatagram> fragments = fragment( datagrams, debug_output );
+
+  reassembly_test( datagrams, fragments, 1, rd, debug_output );
+  reassembly_test( datagrams, fragments, 32, rd, debug_output );
+  reassembly_test( datagrams, fragments, 512, rd, debug_output );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
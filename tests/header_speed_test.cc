@@ -0,0 +1,200 @@
+#include "arp_message.hh"
+#include "ethernet_header.hh"
+#include "helpers.hh"
+#include "ipv4_header.hh"
+#include "packet_buffer.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+constexpr size_t REPETITIONS = 1'000'000;
+constexpr double MAX_NANOSECONDS_PER_HEADER = 200; // (tens of ns is typical; this leaves room for a slow machine)
+constexpr double MAX_NANOSECONDS_PER_PACKET = 1000;
+
+// Serialize `header` into an arena, then parse it back (in place, from the same contiguous bytes), REPETITIONS
+// times
+template<class T, typename... Targs>
+void speed_test( fstream& debug_output, const string& name, const T& header, Targs... parse_args )
+{
+  array<char, 64> arena {};
+  uint64_t sink = 0; // keeps the compiler from optimizing the work away
+
+  const auto serialize_start = steady_clock::now();
+  for ( size_t i = 0; i < REPETITIONS; ++i ) {
+    Serializer s { arena };
+    header.serialize( s );
+    sink += static_cast<uint8_t>( arena[i % s.arena_contents().size()] );
+  }
+  const auto serialize_stop = steady_clock::now();
+
+  Serializer s { arena };
+  header.serialize( s );
+  const string_view wire { s.arena_contents().data(), s.arena_contents().size() };
+
+  // parsing in place must give the same result as parsing an owned copy
+  T from_copy {};
+  T in_place {};
+  if ( not parse( from_copy, array { string { wire } }, parse_args... )
+       or not parse( in_place, wire, parse_args... )
+       or concat( serialize( from_copy ) ) != concat( serialize( in_place ) ) ) {
+    throw runtime_error( name + " parsed differently in place" );
+  }
+
+  const auto parse_start = steady_clock::now();
+  for ( size_t i = 0; i < REPETITIONS; ++i ) {
+    T parsed {};
+    if ( not parse( parsed, wire, parse_args... ) ) {
+      throw runtime_error( name + " failed to parse" );
+    }
+    sink += sizeof( parsed );
+  }
+  const auto parse_stop = steady_clock::now();
+
+  const auto ns_per = [&]( auto start, auto stop ) {
+    return static_cast<double>( duration_cast<nanoseconds>( stop - start ).count() ) / REPETITIONS;
+  };
+  const double serialize_ns = ns_per( serialize_start, serialize_stop );
+  const double parse_ns = ns_per( parse_start, parse_stop );
+
+  cout << name << " (" << wire.size() << " bytes): serialize " << fixed << setprecision( 1 ) << serialize_ns
+       << " ns, parse " << parse_ns << " ns (check " << sink % 10 << ")\n";
+
+  debug_output << "      " << setw( 15 ) << left << name << right << " serialize: " << fixed << setprecision( 1 )
+               << setw( 6 ) << serialize_ns << " ns,  parse: " << setw( 6 ) << parse_ns << " ns\n";
+
+  if ( serialize_ns > MAX_NANOSECONDS_PER_HEADER or parse_ns > MAX_NANOSECONDS_PER_HEADER ) {
+    throw runtime_error( name + " did not meet maximum time of " + to_string( MAX_NANOSECONDS_PER_HEADER )
+                         + " ns per header" );
+  }
+}
+
+// Encapsulate a TCP message in an IPv4 datagram as a list of buffers, and in place in one PacketBuffer (which
+// must produce the same bytes)
+void encapsulation_test( fstream& debug_output )
+{
+  TCPMessage msg;
+  msg.sender->seqno = Wrap32 { 1'000'000 };
+  msg.sender->payload = string( 1000, 'x' );
+  msg.receiver->ackno = Wrap32 { 2'000'000 };
+  msg.receiver->window_size = 65000;
+  const UserDatagramInfo ports { .src_port = 1234, .dst_port = 80, .cksum = 0 };
+
+  // serializing a segment refers to its payload instead of copying it
+  const TCPSegment seg { .message = { msg.sender.borrow(), msg.receiver.borrow() }, .udinfo = ports };
+  const auto segment_buffers = serialize( seg );
+  if ( segment_buffers.size() != 2 or segment_buffers.back().get().data() != msg.sender->payload.data() ) {
+    throw runtime_error( "TCPSegment::serialize copied the payload" );
+  }
+
+  const string listed
+    = concat( serialize( TCPOverIPv4Adapter::wrap_tcp_in_ip( msg, 0x0a000001, 0x0a000002, ports ) ) );
+  const PacketBuffer packet = TCPOverIPv4Adapter::wrap_tcp_in_packet( msg, 0x0a000001, 0x0a000002, ports );
+  if ( packet.data() != listed or packet.headroom() != PacketBuffer::DEFAULT_HEADROOM ) {
+    throw runtime_error( "PacketBuffer encapsulation produced a different datagram" );
+  }
+
+  // the copy of the payload that each datagram takes was summed correctly (with an odd length, too)
+  msg.sender->payload.pop_back();
+  InternetDatagram odd = TCPOverIPv4Adapter::wrap_tcp_in_ip( msg, 0x0a000001, 0x0a000002, ports );
+  TCPSegment parsed;
+  if ( not parse( parsed, move( odd.payload ), odd.header.pseudo_checksum() )
+       or parsed.message.sender->payload != msg.sender->payload ) {
+    throw runtime_error( "wrap_tcp_in_ip produced an invalid segment" );
+  }
+  if ( TCPOverIPv4Adapter::wrap_tcp_in_packet( msg, 0x0a000001, 0x0a000002, ports ).data()
+       != concat( serialize( TCPOverIPv4Adapter::wrap_tcp_in_ip( msg, 0x0a000001, 0x0a000002, ports ) ) ) ) {
+    throw runtime_error( "PacketBuffer encapsulation produced a different datagram (odd-length payload)" );
+  }
+  msg.sender->payload.push_back( 'x' );
+
+  uint64_t sink = 0;
+  const auto listed_start = steady_clock::now();
+  for ( size_t i = 0; i < REPETITIONS; ++i ) {
+    const auto buffers = serialize( TCPOverIPv4Adapter::wrap_tcp_in_ip( msg, 0x0a000001, 0x0a000002, ports ) );
+    sink += buffers.size();
+  }
+  const auto listed_stop = steady_clock::now();
+
+  const auto packet_start = steady_clock::now();
+  for ( size_t i = 0; i < REPETITIONS; ++i ) {
+    sink += TCPOverIPv4Adapter::wrap_tcp_in_packet( msg, 0x0a000001, 0x0a000002, ports ).size();
+  }
+  const auto packet_stop = steady_clock::now();
+
+  const auto ns_per = [&]( auto start, auto stop ) {
+    return static_cast<double>( duration_cast<nanoseconds>( stop - start ).count() ) / REPETITIONS;
+  };
+  const double listed_ns = ns_per( listed_start, listed_stop );
+  const double packet_ns = ns_per( packet_start, packet_stop );
+
+  cout << "TCP/IPv4 encapsulation (" << listed.size() << " bytes): buffer list " << fixed << setprecision( 1 )
+       << listed_ns << " ns, PacketBuffer " << packet_ns << " ns (check " << sink % 10 << ")\n";
+  debug_output << "      " << setw( 15 ) << left << "TCP/IPv4 packet" << right << " buffer list: " << fixed
+               << setprecision( 1 ) << setw( 6 ) << listed_ns << " ns,  in place: " << setw( 6 ) << packet_ns
+               << " ns\n";
+
+  if ( packet_ns > MAX_NANOSECONDS_PER_PACKET ) {
+    throw runtime_error( "PacketBuffer encapsulation did not meet maximum time of "
+                         + to_string( MAX_NANOSECONDS_PER_PACKET ) + " ns per packet" );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  const EthernetHeader eth {
+    .dst = { 1, 2, 3, 4, 5, 6 }, .src = { 7, 8, 9, 10, 11, 12 }, .type = EthernetHeader::TYPE_IPv4 };
+  speed_test( debug_output, "Ethernet header", eth );
+
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REQUEST;
+  arp.sender_ethernet_address = eth.src;
+  arp.sender_ip_address = 0x0a000001;
+  arp.target_ip_address = 0x0a000002;
+  speed_test( debug_output, "ARP message", arp );
+
+  IPv4Header ip;
+  ip.len = IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH;
+  ip.src = 0x0a000001;
+  ip.dst = 0x0a000002;
+  ip.compute_checksum();
+  speed_test( debug_output, "IPv4 header", ip );
+
+  TCPSegment tcp;
+  tcp.udinfo = { .src_port = 1234, .dst_port = 80, .cksum = 0 };
+  tcp.message.sender->seqno = Wrap32 { 1'000'000 };
+  tcp.message.receiver->ackno = Wrap32 { 2'000'000 };
+  tcp.message.receiver->window_size = 65000;
+  tcp.compute_checksum( ip.pseudo_checksum() );
+  speed_test( debug_output, "TCP header", tcp, ip.pseudo_checksum() );
+
+  encapsulation_test( debug_output );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
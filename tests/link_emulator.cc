@@ -0,0 +1,221 @@
+#include "fd_adapter.hh"
+#include "link_emulator.hh"
+#include "netem_fd_adapter.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "LinkEmulator: " + what );
+  }
+}
+
+// Run the link 1 ms at a time until nothing is in flight, and return each packet with the time it arrived
+vector<pair<uint64_t, uint64_t>> drain( LinkEmulator<uint64_t>& link )
+{
+  vector<pair<uint64_t, uint64_t>> arrivals;
+  while ( true ) {
+    while ( auto packet = link.receive() ) {
+      arrivals.emplace_back( link.now_ms(), *packet );
+    }
+    if ( link.in_flight() == 0 ) {
+      return arrivals;
+    }
+    link.tick( 1 );
+  }
+}
+
+void rate_test()
+{
+  // 1000 bytes per ms, and room for a packet and a half in the bucket
+  LinkEmulator<uint64_t> link { { .rate_bytes_per_s = 1'000'000, .burst_bytes = 1500 } };
+  for ( uint64_t i = 0; i < 100; ++i ) {
+    expect( link.send( i, 1000 ), "dropped a packet without a queue limit" );
+  }
+
+  // the first packet leaves at once, and the rest as the bucket refills: packet i (> 0) at i - 0.5 ms
+  const auto arrivals = drain( link );
+  expect( arrivals.size() == 100, "lost packets" );
+  for ( uint64_t i = 0; i < 100; ++i ) {
+    expect( arrivals[i].second == i, "reordered packets" );
+    expect( arrivals[i].first == i, "packet " + to_string( i ) + " arrived at " + to_string( arrivals[i].first ) );
+  }
+
+  // after an idle period, a burst goes at once
+  link.tick( 10 );
+  expect( link.send( 100, 1500 ) and link.receive() == 100, "did not let a full bucket's worth through at once" );
+}
+
+void delay_test()
+{
+  LinkEmulator<uint64_t> link { { .delay_ms = 50, .jitter_ms = 10, .seed = 1 } };
+  for ( uint64_t i = 0; i < 1000; ++i ) {
+    link.send( i, 100 );
+  }
+  const auto arrivals = drain( link );
+  expect( arrivals.size() == 1000, "lost packets" );
+
+  bool reordered = false;
+  for ( size_t i = 0; i < arrivals.size(); ++i ) {
+    expect( arrivals[i].first >= 40 and arrivals[i].first <= 60, "delay outside of 50 +/- 10 ms" );
+    reordered |= arrivals[i].second != i;
+  }
+  expect( reordered, "jitter did not reorder any packets" );
+}
+
+void queue_test()
+{
+  // each 100-byte packet takes 100 ms to leave
+  LinkEmulator<uint64_t> link { { .rate_bytes_per_s = 1000, .queue_limit = 5 } };
+  uint64_t accepted = 0;
+  for ( uint64_t i = 0; i < 10; ++i ) {
+    accepted += link.send( i, 100 );
+  }
+  expect( accepted == 5 and link.stats().queue_drops == 5, "did not drop what didn't fit in the queue" );
+
+  link.tick( 100 );
+  expect( link.send( 10, 100 ), "did not make room as the queue drained" );
+  expect( not link.send( 11, 100 ), "did not drop when the queue was full again" );
+}
+
+void loss_test()
+{
+  // bursts of losses: on average 1 in 11 packets is lost, in bursts of 10
+  constexpr uint64_t packets = 200'000;
+  LinkEmulator<uint64_t> link { { .loss_bad = 1, .good_to_bad = 0.01, .bad_to_good = 0.1, .seed = 2 } };
+  uint64_t lost = 0;
+  uint64_t bursts = 0;
+  bool previous_lost = false;
+  for ( uint64_t i = 0; i < packets; ++i ) {
+    const bool this_lost = not link.send( i, 100 );
+    lost += this_lost;
+    bursts += this_lost and not previous_lost;
+    previous_lost = this_lost;
+  }
+
+  const double loss_rate = static_cast<double>( lost ) / packets;
+  const double burst_length = static_cast<double>( lost ) / static_cast<double>( bursts );
+  expect( loss_rate > 0.08 and loss_rate < 0.10, "loss rate " + to_string( loss_rate ) + " instead of 0.09" );
+  expect( burst_length > 8 and burst_length < 12, "bursts of " + to_string( burst_length ) + " instead of 10" );
+  expect( link.stats().lost == lost, "miscounted losses" );
+}
+
+void duplicate_and_reorder_test()
+{
+  LinkEmulator<uint64_t> link { { .delay_ms = 20, .reorder = 0.25, .duplicate = 0.5, .seed = 3 } };
+  for ( uint64_t i = 0; i < 10'000; ++i ) {
+    link.send( i, 100 );
+    link.tick( 1 );
+  }
+  const auto arrivals = drain( link );
+  expect( arrivals.size() == 10'000 + link.stats().duplicated, "miscounted duplicates" );
+  expect( link.stats().duplicated > 4500 and link.stats().duplicated < 5500, "duplicated about half the packets" );
+  expect( link.stats().reordered > 3400 and link.stats().reordered < 4100, "reordered about a quarter" );
+}
+
+void determinism_test()
+{
+  const LinkConfig config { .rate_bytes_per_s = 100'000,
+                            .burst_bytes = 3000,
+                            .queue_limit = 20,
+                            .delay_ms = 10,
+                            .jitter_ms = 5,
+                            .reorder = 0.05,
+                            .duplicate = 0.05,
+                            .loss_good = 0.01,
+                            .loss_bad = 0.5,
+                            .good_to_bad = 0.05,
+                            .bad_to_good = 0.3,
+                            .seed = 4 };
+  const auto run = []( const LinkConfig& c ) {
+    LinkEmulator<uint64_t> link { c };
+    for ( uint64_t i = 0; i < 5000; ++i ) {
+      link.send( i, 500 + i % 1000 );
+      link.tick( i % 3 );
+    }
+    return drain( link );
+  };
+
+  expect( run( config ) == run( config ), "the same seed gave different results" );
+  LinkConfig other = config;
+  other.seed = 5;
+  expect( run( config ) != run( other ), "different seeds gave the same results" );
+}
+// An FD adapter that keeps the payload of every segment written to it
+class RecordingAdapter : public FdAdapterBase
+{
+public:
+  shared_ptr<vector<string>> written = make_shared<vector<string>>();
+
+  void write( const TCPMessage& seg ) { written->push_back( seg.sender->payload ); }
+  optional<TCPMessage> read() { return {}; }
+};
+
+TCPMessage segment( const string& payload )
+{
+  TCPMessage seg;
+  seg.sender->payload = payload;
+  return seg;
+}
+
+// Segments written to a NetemFdAdapter reach the underlying adapter as the link delivers them, on tick(), and
+// flush() writes out whatever is still in flight
+void netem_fd_adapter_test()
+{
+  RecordingAdapter recorder;
+  const auto written = recorder.written;
+  NetemFdAdapter<RecordingAdapter> adapter { move( recorder ), { .delay_ms = 50 } };
+
+  adapter.write( segment( "a" ) );
+  adapter.tick( 20 );
+  adapter.write( segment( "b" ) );
+  expect( written->empty() and adapter.uplink().in_flight() == 2, "wrote a segment before its delay" );
+
+  adapter.tick( 30 );
+  expect( *written == vector<string> { "a" }, "did not write a segment once it arrived" );
+
+  // the last segment sent (e.g. a final ACK) is written out even if nothing ticks any more
+  adapter.write( segment( "c" ) );
+  adapter.flush();
+  expect( *written == vector<string> { "a", "b", "c" }, "did not flush the segments in flight" );
+  expect( adapter.uplink().in_flight() == 0, "segments still in flight after a flush" );
+
+  // without a delay, a segment goes straight through
+  RecordingAdapter direct_recorder;
+  const auto direct_written = direct_recorder.written;
+  NetemFdAdapter<RecordingAdapter> direct { move( direct_recorder ), {} };
+  direct.write( segment( "d" ) );
+  expect( *direct_written == vector<string> { "d" }, "held a segment on a link without delay" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    rate_test();
+    delay_test();
+    queue_test();
+    loss_test();
+    duplicate_and_reorder_test();
+    determinism_test();
+    netem_fd_adapter_test();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -4,6 +4,7 @@
 #include "network_interface_test_harness.hh"
 
 #include <cstdlib>
+#include <functional>
 #include <iostream>
 #include <random>
 
@@ -47,6 +48,36 @@ ARPMessage make_arp( const uint16_t opcode,
   return arp;
 }
 
+// A datagram that may be fragmented, with `size` bytes of payload
+InternetDatagram make_large_datagram( const string& src_ip, const string& dst_ip, size_t size )
+{
+  InternetDatagram dgram = make_datagram( src_ip, dst_ip );
+  string payload( size, 0 );
+  for ( size_t i = 0; i < size; ++i ) {
+    payload[i] = static_cast<char>( 'a' + i % 26 );
+  }
+  dgram.payload.clear();
+  dgram.payload.emplace_back( move( payload ) );
+  dgram.header.id = 0x1234;
+  dgram.header.df = false;
+  dgram.header.len = static_cast<uint16_t>( IPv4Header::LENGTH + size );
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// The fragment of `dgram` that carries bytes [begin, begin + length) of its payload
+InternetDatagram make_fragment( const InternetDatagram& dgram, size_t begin, size_t length, bool more )
+{
+  InternetDatagram fragment;
+  fragment.header = dgram.header;
+  fragment.header.offset = static_cast<uint16_t>( begin / 8 );
+  fragment.header.mf = more;
+  fragment.header.len = static_cast<uint16_t>( IPv4Header::LENGTH + length );
+  fragment.header.compute_checksum();
+  fragment.payload.emplace_back( concat( dgram.payload ).substr( begin, length ) );
+  return fragment;
+}
+
 EthernetFrame make_frame( const EthernetAddress& src,
                           const EthernetAddress& dst,
                           const uint16_t type,
@@ -60,6 +91,24 @@ EthernetFrame make_frame( const EthernetAddress& src,
   return frame;
 }
 
+// An output port that runs `reenter` (once) when it is first given an IPv4 frame, e.g. to send more datagrams
+// on the interface from inside its transmit()
+class ReentrantPort : public NetworkInterface::OutputPort
+{
+public:
+  std::vector<EthernetFrame> frames {};
+  std::function<void()> reenter {};
+
+  void transmit( const NetworkInterface& n [[maybe_unused]], const EthernetFrame& x ) override
+  {
+    frames.push_back( clone( x ) );
+    if ( x.header.type == EthernetHeader::TYPE_IPv4 and reenter ) {
+      auto f = std::exchange( reenter, {} );
+      f();
+    }
+  }
+};
+
 int main()
 {
   try {
@@ -561,6 +610,283 @@ int main()
       test.execute( ExpectNoFrame {} );
     }
 
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress target_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "busy mappings are refreshed before they expire", local_eth, Address( "4.3.2.1", 0 ) };
+
+      const auto datagram = make_datagram( "5.6.7.8", "13.12.11.10" );
+      test.execute( SendDatagram { datagram, Address( "192.168.0.1", 0 ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.1" ) ) ) } );
+
+      const auto reply = make_frame(
+        target_eth,
+        local_eth,
+        EthernetHeader::TYPE_ARP, // NOLINTNEXTLINE(*-suspicious-*)
+        serialize( make_arp( ARPMessage::OPCODE_REPLY, target_eth, "192.168.0.1", local_eth, "4.3.2.1" ) ) );
+      test.execute( ReceiveFrame { reply } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( datagram ) ) } );
+
+      // a steady flow for two minutes: five seconds before the mapping would expire, the interface asks the
+      // neighbor (by unicast) to confirm it, so no datagram ever has to wait for an ARP reply
+      for ( int ms = 100; ms <= 120000; ms += 100 ) {
+        test.execute( Tick { 100 } );
+        if ( ms % 25000 == 0 ) {
+          test.execute( ExpectFrame { make_frame(
+            local_eth,
+            target_eth,
+            EthernetHeader::TYPE_ARP,
+            serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.1" ) ) ) } );
+          test.execute( ReceiveFrame { reply } );
+        }
+        test.execute( ExpectNoFrame {} );
+
+        test.execute( SendDatagram { datagram, Address( "192.168.0.1", 0 ) } );
+        test.execute(
+          ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( datagram ) ) } );
+      }
+      test.execute( ExpectPendingDrops { 0, 0 } );
+    }
+
+    for ( const auto policy : { NetworkInterface::DropPolicy::DROP_TAIL, NetworkInterface::DropPolicy::DROP_HEAD } ) {
+      const bool drop_head = policy == NetworkInterface::DropPolicy::DROP_HEAD;
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { drop_head ? "pending queue drops oldest datagrams when full"
+                                                   : "pending queue drops new datagrams when full",
+                                         local_eth,
+                                         Address( "4.3.2.1", 0 ) };
+
+      NetworkInterface::PendingLimits limits;
+      limits.max_datagrams_per_neighbor = 3;
+      limits.policy = policy;
+      test.execute( SetPendingLimits { limits } );
+
+      vector<InternetDatagram> datagrams;
+      for ( int i = 1; i <= 5; i++ ) {
+        datagrams.push_back( make_datagram( "5.6.7.8", "13.12.11." + to_string( i ) ) );
+        test.execute( SendDatagram { datagrams.back(), Address( "192.168.0.1", 0 ) } );
+      }
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.1" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingDrops { 2, 0 } );
+
+      const EthernetAddress target_eth = random_private_ethernet_address();
+      test.execute( ReceiveFrame { make_frame(
+        target_eth,
+        local_eth,
+        EthernetHeader::TYPE_ARP, // NOLINTNEXTLINE(*-suspicious-*)
+        serialize( make_arp( ARPMessage::OPCODE_REPLY, target_eth, "192.168.0.1", local_eth, "4.3.2.1" ) ) ) } );
+
+      // only three of the datagrams were kept: the first three, or the last three
+      for ( size_t i = drop_head ? 2 : 0; i < ( drop_head ? 5U : 3U ); i++ ) {
+        test.execute( ExpectFrame {
+          make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( datagrams.at( i ) ) ) } );
+      }
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "pending queue limit shared by all neighbors", local_eth, Address( "4.3.2.1", 0 ) };
+
+      NetworkInterface::PendingLimits limits;
+      limits.max_datagrams = 2;
+      limits.policy = NetworkInterface::DropPolicy::DROP_HEAD;
+      test.execute( SetPendingLimits { limits } );
+
+      const auto datagram_1 = make_datagram( "5.6.7.8", "13.12.11.1" );
+      const auto datagram_2 = make_datagram( "5.6.7.8", "13.12.11.2" );
+      const auto datagram_3 = make_datagram( "5.6.7.8", "13.12.11.3" );
+      test.execute( SendDatagram { datagram_1, Address( "192.168.0.1", 0 ) } );
+      test.execute( SendDatagram { datagram_2, Address( "192.168.0.1", 0 ) } );
+
+      // the interface is full, and the new neighbor has nothing queued to make room with
+      test.execute( SendDatagram { datagram_3, Address( "192.168.0.2", 0 ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.1" ) ) ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.2" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingDrops { 1, 0 } );
+
+      // when the first neighbor doesn't answer, its datagrams expire and free up room
+      test.execute( Tick { 5001 } );
+      test.execute( ExpectPendingDrops { 1, 2 } );
+      test.execute( SendDatagram { datagram_3, Address( "192.168.0.2", 0 ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.2" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+
+      const EthernetAddress target_eth = random_private_ethernet_address();
+      test.execute( ReceiveFrame { make_frame(
+        target_eth,
+        local_eth,
+        EthernetHeader::TYPE_ARP, // NOLINTNEXTLINE(*-suspicious-*)
+        serialize( make_arp( ARPMessage::OPCODE_REPLY, target_eth, "192.168.0.2", local_eth, "4.3.2.1" ) ) ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( datagram_3 ) ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingDrops { 1, 2 } );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "datagrams larger than the MTU are fragmented", local_eth, Address( "5.5.5.5", 0 ) };
+      test.execute( SetMTU { 68 } ); // (48 bytes of payload per fragment)
+      test.execute( ReceiveFrame { make_frame(
+        remote_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, remote_eth, "10.0.1.1", {}, "5.5.5.5" ) ) ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        remote_eth,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REPLY, local_eth, "5.5.5.5", remote_eth, "10.0.1.1" ) ) ) } );
+
+      // a datagram that fits goes as it is
+      const auto small = make_large_datagram( "5.6.7.8", "13.12.11.10", 48 );
+      test.execute( SendDatagram { small, Address( "10.0.1.1", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( small ) ) } );
+
+      const auto large = make_large_datagram( "5.6.7.8", "13.12.11.10", 100 );
+      test.execute( SendDatagram { large, Address( "10.0.1.1", 0 ) } );
+      for ( const auto& fragment : { make_fragment( large, 0, 48, true ),
+                                     make_fragment( large, 48, 48, true ),
+                                     make_fragment( large, 96, 4, false ) } ) {
+        test.execute(
+          ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( fragment ) ) } );
+      }
+      test.execute( ExpectNoFrame {} );
+
+      // a fragment is fragmented further, keeping its place in the original datagram
+      const auto original = make_large_datagram( "5.6.7.8", "13.12.11.10", 200 );
+      test.execute( SendDatagram { make_fragment( original, 64, 56, true ), Address( "10.0.1.1", 0 ) } );
+      const auto pieces = { make_fragment( original, 64, 48, true ), make_fragment( original, 112, 8, true ) };
+      for ( const auto& piece : pieces ) {
+        test.execute(
+          ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( piece ) ) } );
+      }
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectFragmentStats { 2, 5, 0 } );
+
+      // a datagram that may not be fragmented is dropped
+      auto unfragmentable = make_large_datagram( "5.6.7.8", "13.12.11.10", 100 );
+      unfragmentable.header.df = true;
+      unfragmentable.header.compute_checksum();
+      test.execute( SendDatagram { unfragmentable, Address( "10.0.1.1", 0 ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectFragmentStats { 2, 5, 1 } );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "fragments are reassembled", local_eth, Address( "5.5.5.5", 0 ) };
+      test.execute( SetReassembleFragments { true } );
+
+      // out of order, with a duplicate and an overlap
+      const auto large = make_large_datagram( "13.12.11.10", "5.5.5.5", 100 );
+      const auto last = make_fragment( large, 96, 4, false );
+      const auto middle = make_fragment( large, 48, 48, true );
+      const auto overlap = make_fragment( large, 40, 16, true );
+      const auto first = make_fragment( large, 0, 48, true );
+      for ( const auto* fragment : { &last, &middle, &middle, &overlap } ) {
+        test.execute(
+          ReceiveFrame { make_frame( remote_eth, local_eth, EthernetHeader::TYPE_IPv4, serialize( *fragment ) ) } );
+      }
+      test.execute( ReceiveFrame {
+        make_frame( remote_eth, local_eth, EthernetHeader::TYPE_IPv4, serialize( first ) ), large } );
+
+      // an incomplete datagram is given up on after 30 seconds
+      test.execute(
+        ReceiveFrame { make_frame( remote_eth, local_eth, EthernetHeader::TYPE_IPv4, serialize( first ) ) } );
+      test.execute( Tick { 30000 } );
+      test.execute(
+        ReceiveFrame { make_frame( remote_eth, local_eth, EthernetHeader::TYPE_IPv4, serialize( middle ) ) } );
+      test.execute(
+        ReceiveFrame { make_frame( remote_eth, local_eth, EthernetHeader::TYPE_IPv4, serialize( last ) ) } );
+    }
+
+    {
+      // the output port sends more datagrams (to new neighbors, and to the one whose queue is being sent) while
+      // the interface is sending the datagrams that waited for an ARP reply: the neighbor table grows meanwhile
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress target_eth = random_private_ethernet_address();
+      auto port = make_shared<ReentrantPort>();
+      NetworkInterface iface { "reentrant", port, local_eth, Address( "4.3.2.1", 0 ) };
+
+      vector<InternetDatagram> queued;
+      for ( int i = 0; i < 4; ++i ) {
+        queued.push_back( make_datagram( "5.6.7.8", "13.12.11." + to_string( i ) ) );
+        iface.send_datagram( queued.back(), Address( "192.168.0.1", 0 ) );
+      }
+      const InternetDatagram extra = make_datagram( "5.6.7.8", "13.12.11.99" );
+      port->reenter = [&] {
+        for ( int i = 0; i < 64; ++i ) {
+          iface.send_datagram( make_datagram( "5.6.7.8", "1.2.3.4" ), Address( "10.0.1." + to_string( i ), 0 ) );
+        }
+        iface.send_datagram( extra, Address( "192.168.0.1", 0 ) );
+      };
+
+      iface.recv_frame( make_frame(
+        target_eth,
+        local_eth,
+        EthernetHeader::TYPE_ARP, // NOLINTNEXTLINE(*-suspicious-*)
+        serialize( make_arp( ARPMessage::OPCODE_REPLY, target_eth, "192.168.0.1", local_eth, "4.3.2.1" ) ) ) );
+
+      vector<string> sent;
+      size_t arp_requests = 0;
+      for ( const auto& frame : port->frames ) {
+        if ( frame.header.type == EthernetHeader::TYPE_IPv4 ) {
+          if ( frame.header.dst != target_eth ) {
+            throw runtime_error( "reentrant send: datagram sent to the wrong Ethernet address" );
+          }
+          sent.push_back( concat( frame.payload ) );
+        } else if ( frame.header.type == EthernetHeader::TYPE_ARP ) {
+          ++arp_requests;
+        }
+      }
+      // the first queued datagram is sent before the port re-enters, so the new one goes out right after it
+      vector<string> expected { concat( serialize( queued[0] ) ), concat( serialize( extra ) ) };
+      for ( size_t i = 1; i < queued.size(); ++i ) {
+        expected.push_back( concat( serialize( queued[i] ) ) );
+      }
+      if ( sent != expected ) {
+        throw runtime_error( "reentrant send: expected " + to_string( expected.size() )
+                             + " datagrams in order, got " + to_string( sent.size() ) );
+      }
+      if ( arp_requests != 1 + 64 ) { // (the request for 192.168.0.1, then one per new neighbor)
+        throw runtime_error( "reentrant send: expected 65 ARP requests, got " + to_string( arp_requests ) );
+      }
+      if ( iface.pending_stats().datagrams_expired != 0 ) {
+        throw runtime_error( "reentrant send: no datagram should have expired" );
+      }
+    }
+
     // Test credit: Shiva Khanna Yamamoto
     {
       const EthernetAddress local_eth = random_private_ethernet_address();
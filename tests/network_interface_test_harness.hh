@@ -148,3 +148,97 @@ struct Tick : public Action<InterfaceAndOutput>
 
   explicit Tick( const size_t ms ) : _ms( ms ) {}
 };
+
+struct SetPendingLimits : public Action<InterfaceAndOutput>
+{
+  NetworkInterface::PendingLimits limits;
+
+  std::string description() const override
+  {
+    return "limit pending datagrams to " + std::to_string( limits.max_datagrams_per_neighbor ) + " per neighbor ("
+           + std::to_string( limits.max_bytes_per_neighbor ) + " bytes) and "
+           + std::to_string( limits.max_datagrams ) + " in total (" + std::to_string( limits.max_bytes )
+           + " bytes), "
+           + ( limits.policy == NetworkInterface::DropPolicy::DROP_HEAD ? "dropping oldest" : "dropping newest" );
+  }
+
+  void execute( InterfaceAndOutput& interface ) const override { interface.first.set_pending_limits( limits ); }
+
+  explicit SetPendingLimits( const NetworkInterface::PendingLimits& l ) : limits( l ) {}
+};
+
+struct ExpectPendingDrops : public Expectation<InterfaceAndOutput>
+{
+  uint64_t dropped;
+  uint64_t expired;
+
+  std::string description() const override
+  {
+    return std::to_string( dropped ) + " pending datagrams dropped and " + std::to_string( expired ) + " expired";
+  }
+
+  void execute( const InterfaceAndOutput& interface ) const override
+  {
+    const auto& stats = interface.first.pending_stats();
+    if ( stats.datagrams_dropped != dropped or stats.datagrams_expired != expired ) {
+      throw ExpectationViolation( "NetworkInterface reported " + std::to_string( stats.datagrams_dropped )
+                                  + " pending datagrams dropped and " + std::to_string( stats.datagrams_expired )
+                                  + " expired" );
+    }
+  }
+
+  ExpectPendingDrops( uint64_t d, uint64_t e ) : dropped( d ), expired( e ) {}
+};
+
+struct SetMTU : public Action<InterfaceAndOutput>
+{
+  size_t mtu;
+
+  std::string description() const override { return "set MTU to " + std::to_string( mtu ); }
+  void execute( InterfaceAndOutput& interface ) const override { interface.first.set_mtu( mtu ); }
+
+  explicit SetMTU( size_t m ) : mtu( m ) {}
+};
+
+struct SetReassembleFragments : public Action<InterfaceAndOutput>
+{
+  bool reassemble;
+
+  std::string description() const override
+  {
+    return reassemble ? "reassemble fragments" : "pass fragments up unchanged";
+  }
+  void execute( InterfaceAndOutput& interface ) const override
+  {
+    interface.first.set_reassemble_fragments( reassemble );
+  }
+
+  explicit SetReassembleFragments( bool r ) : reassemble( r ) {}
+};
+
+struct ExpectFragmentStats : public Expectation<InterfaceAndOutput>
+{
+  uint64_t fragmented;
+  uint64_t fragments;
+  uint64_t too_big;
+
+  std::string description() const override
+  {
+    return std::to_string( fragmented ) + " datagrams sent as " + std::to_string( fragments ) + " fragments, and "
+           + std::to_string( too_big ) + " too big to send";
+  }
+
+  void execute( const InterfaceAndOutput& interface ) const override
+  {
+    const auto& stats = interface.first.fragment_stats();
+    if ( stats.datagrams_fragmented != fragmented or stats.fragments_sent != fragments
+         or stats.datagrams_too_big != too_big ) {
+      throw ExpectationViolation( "NetworkInterface reported " + std::to_string( stats.datagrams_fragmented )
+                                  + " datagrams sent as " + std::to_string( stats.fragments_sent )
+                                  + " fragments, and " + std::to_string( stats.datagrams_too_big )
+                                  + " too big to send" );
+    }
+  }
+
+  ExpectFragmentStats( uint64_t d, uint64_t f, uint64_t t ) : fragmented( d ), fragments( f ), too_big( t ) {}
+};
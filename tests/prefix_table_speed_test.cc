@@ -0,0 +1,211 @@
+#include "prefix_table.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+constexpr size_t NUM_LOOKUPS = 10'000'000;
+constexpr size_t NUM_CHECKS = 200'000;
+
+struct Prefix
+{
+  uint32_t route_prefix;
+  uint8_t prefix_length;
+};
+
+uint32_t mask( uint8_t prefix_length )
+{
+  return prefix_length == 0 ? 0 : ~0U << ( 32 - prefix_length );
+}
+
+// Random prefixes with roughly the length distribution of a BGP table (mostly /24, then /16-/23,
+// with a few shorter and longer ones)
+vector<Prefix> random_prefixes( default_random_engine& rd, size_t count )
+{
+  uniform_int_distribution<uint32_t> address;
+  uniform_int_distribution<int> percent { 0, 99 };
+  vector<Prefix> ret;
+  ret.reserve( count );
+  for ( size_t i = 0; i < count; ++i ) {
+    const int p = percent( rd );
+    uint8_t len {};
+    if ( p < 60 ) {
+      len = 24;
+    } else if ( p < 98 ) {
+      len = static_cast<uint8_t>( uniform_int_distribution<unsigned> { 16, 23 }( rd ) );
+    } else if ( p < 99 ) {
+      len = static_cast<uint8_t>( uniform_int_distribution<unsigned> { 8, 15 }( rd ) );
+    } else {
+      len = static_cast<uint8_t>( uniform_int_distribution<unsigned> { 25, 32 }( rd ) );
+    }
+    ret.push_back( { address( rd ) & mask( len ), len } );
+  }
+  return ret;
+}
+
+// A straightforward longest-prefix match (probe every length, longest first) to check the table against
+class ReferenceTable
+{
+  unordered_map<uint64_t, uint32_t> prefixes_ {};
+
+  static uint64_t key( uint32_t route_prefix, uint8_t prefix_length )
+  {
+    return uint64_t { prefix_length } << 32 | route_prefix;
+  }
+
+public:
+  void insert( const Prefix& p, uint32_t value ) { prefixes_[key( p.route_prefix, p.prefix_length )] = value; }
+  void erase( const Prefix& p ) { prefixes_.erase( key( p.route_prefix, p.prefix_length ) ); }
+
+  optional<uint32_t> lookup( uint32_t address ) const
+  {
+    for ( int len = 32; len >= 0; --len ) {
+      const auto l = static_cast<uint8_t>( len );
+      const auto it = prefixes_.find( key( address & mask( l ), l ) );
+      if ( it != prefixes_.end() ) {
+        return it->second;
+      }
+    }
+    return {};
+  }
+};
+
+// Half the probes fall inside a (random) installed prefix, half are uniformly random
+vector<uint32_t> random_addresses( default_random_engine& rd, const vector<Prefix>& prefixes, size_t count )
+{
+  uniform_int_distribution<uint32_t> address;
+  uniform_int_distribution<size_t> which { 0, prefixes.size() - 1 };
+  vector<uint32_t> ret;
+  ret.reserve( count );
+  for ( size_t i = 0; i < count; ++i ) {
+    const uint32_t random = address( rd );
+    if ( i % 2 ) {
+      ret.push_back( random );
+    } else {
+      const Prefix& p = prefixes[which( rd )];
+      ret.push_back( p.route_prefix | ( random & ~mask( p.prefix_length ) ) );
+    }
+  }
+  return ret;
+}
+
+void check( const PrefixTable& table, const ReferenceTable& reference, const vector<uint32_t>& addresses )
+{
+  for ( size_t i = 0; i < min( NUM_CHECKS, addresses.size() ); ++i ) {
+    if ( table.lookup( addresses[i] ) != reference.lookup( addresses[i] ) ) {
+      throw runtime_error( "PrefixTable disagrees with reference longest-prefix match" );
+    }
+  }
+}
+
+void speed_test( fstream& debug_output, const size_t num_routes )
+{
+  default_random_engine rd { static_cast<unsigned>( num_routes ) };
+  const vector<Prefix> prefixes = random_prefixes( rd, num_routes );
+
+  PrefixTable table;
+  ReferenceTable reference;
+  reference.insert( { 0, 0 }, 0 );
+  table.insert( 0, 0, 0 ); // a default route
+
+  const auto insert_start = steady_clock::now();
+  for ( size_t i = 0; i < prefixes.size(); ++i ) {
+    table.insert( prefixes[i].route_prefix, prefixes[i].prefix_length, static_cast<uint32_t>( i ) );
+  }
+  const auto insert_stop = steady_clock::now();
+
+  for ( size_t i = 0; i < prefixes.size(); ++i ) {
+    reference.insert( prefixes[i], static_cast<uint32_t>( i ) );
+  }
+
+  const vector<uint32_t> addresses = random_addresses( rd, prefixes, NUM_LOOKUPS / 10 );
+  check( table, reference, addresses );
+
+  uint64_t sink = 0;
+  const auto lookup_start = steady_clock::now();
+  for ( size_t i = 0; i < NUM_LOOKUPS; ++i ) {
+    sink += table.lookup( addresses[i % addresses.size()] ).value_or( 1 );
+  }
+  const auto lookup_stop = steady_clock::now();
+
+  // the same lookups, a whole array at a time
+  vector<optional<uint32_t>> results( addresses.size() );
+  const auto batch_start = steady_clock::now();
+  for ( size_t done = 0; done < NUM_LOOKUPS; done += addresses.size() ) {
+    table.lookup_batch( addresses, results );
+    sink += results[done % results.size()].value_or( 1 );
+  }
+  const auto batch_stop = steady_clock::now();
+
+  for ( size_t i = 0; i < addresses.size(); ++i ) {
+    if ( results[i] != table.lookup( addresses[i] ) ) {
+      throw runtime_error( "PrefixTable::lookup_batch disagrees with lookup" );
+    }
+  }
+
+  // erase every other prefix, and check that lookups fall back to the remaining ones
+  const size_t memory_before_erase = table.memory_usage();
+  for ( size_t i = 0; i < prefixes.size(); i += 2 ) {
+    table.erase( prefixes[i].route_prefix, prefixes[i].prefix_length );
+    reference.erase( prefixes[i] );
+  }
+  for ( size_t i = 1; i < prefixes.size(); i += 2 ) { // (duplicates of erased prefixes must come back)
+    if ( not table.find( prefixes[i].route_prefix, prefixes[i].prefix_length ) ) {
+      table.insert( prefixes[i].route_prefix, prefixes[i].prefix_length, static_cast<uint32_t>( i ) );
+      reference.insert( prefixes[i], static_cast<uint32_t>( i ) );
+    }
+  }
+  check( table, reference, addresses );
+
+  const double insert_ns
+    = static_cast<double>( duration_cast<nanoseconds>( insert_stop - insert_start ).count() ) / num_routes;
+  const auto lookup_duration = duration_cast<duration<double>>( lookup_stop - lookup_start );
+  const double lookups_per_second = static_cast<double>( NUM_LOOKUPS ) / lookup_duration.count();
+  const auto batch_duration = duration_cast<duration<double>>( batch_stop - batch_start );
+  const double batch_lookups_per_second = static_cast<double>( NUM_LOOKUPS ) / batch_duration.count();
+  const double megabytes = static_cast<double>( memory_before_erase ) / ( 1 << 20 );
+
+  cout << "PrefixTable with " << num_routes << " routes: " << fixed << setprecision( 0 ) << lookups_per_second
+       << " lookups/s (" << batch_lookups_per_second << " batched), " << setprecision( 1 ) << megabytes
+       << " MiB, " << insert_ns << " ns per insert (check " << sink % 10 << ")\n";
+
+  debug_output << "      PrefixTable (" << setw( 7 ) << num_routes << " routes): " << fixed << setprecision( 0 )
+               << setw( 10 ) << lookups_per_second << " lookups/s (" << setw( 10 ) << batch_lookups_per_second
+               << " batched), " << setprecision( 1 ) << setw( 6 ) << megabytes << " MiB\n";
+
+  if ( min( lookups_per_second, batch_lookups_per_second ) < 1'000'000 ) {
+    throw runtime_error( "PrefixTable did not meet minimum rate of 1000000 lookups/s" );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  speed_test( debug_output, 1'000 );
+  speed_test( debug_output, 100'000 );
+  speed_test( debug_output, 1'000'000 );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+#include "arp_message.hh"
+#include "helpers.hh"
+#include "router.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+constexpr size_t NUM_INTERFACES = 3;
+constexpr size_t NUM_DATAGRAMS = 3000;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "Router: " + what );
+  }
+}
+
+// An output port that keeps every frame it is given (serialized)
+class RecordingPort : public NetworkInterface::OutputPort
+{
+public:
+  vector<string> frames {};
+  void transmit( const NetworkInterface& /* sender */, const EthernetFrame& frame ) override
+  {
+    frames.push_back( concat( serialize( frame ) ) );
+  }
+};
+
+Address ip( size_t i, uint32_t host )
+{
+  return Address::from_ipv4_numeric( 0x0a00'0000 | static_cast<uint32_t>( i ) << 16 | host );
+}
+
+EthernetAddress ethernet( size_t i, uint8_t host )
+{
+  return { 2, 0, 0, 0, static_cast<uint8_t>( i ), host };
+}
+
+// Route `datagrams` (each given to the interface it names) in serial or parallel mode, and return what each
+// interface sent. Interface i is 10.i.0.1, and reaches 10.i.0.0/16 through the neighbor 10.i.0.2 (whose Ethernet
+// address it knows); the last interface also reaches 172.16.0.0/12 directly (so it sends ARP requests). There is
+// no default route.
+vector<vector<string>> route_all( const vector<pair<size_t, InternetDatagram>>& datagrams, bool parallel )
+{
+  Router router;
+  vector<shared_ptr<RecordingPort>> ports;
+  for ( size_t i = 0; i < NUM_INTERFACES; ++i ) {
+    ports.push_back( make_shared<RecordingPort>() );
+    router.add_interface(
+      make_shared<NetworkInterface>( "eth" + to_string( i ), ports.back(), ethernet( i, 1 ), ip( i, 1 ) ) );
+
+    ARPMessage arp;
+    arp.opcode = ARPMessage::OPCODE_REPLY;
+    arp.sender_ethernet_address = ethernet( i, 2 );
+    arp.sender_ip_address = ip( i, 2 ).ipv4_numeric();
+    arp.target_ethernet_address = ethernet( i, 1 );
+    arp.target_ip_address = ip( i, 1 ).ipv4_numeric();
+    router.interface( i )->recv_frame(
+      { .header = { .dst = ethernet( i, 1 ), .src = ethernet( i, 2 ), .type = EthernetHeader::TYPE_ARP },
+        .payload = serialize( arp ) } );
+
+    router.add_route( ip( i, 0 ).ipv4_numeric(), 16, ip( i, 2 ), i );
+  }
+  router.add_route( 0xac10'0000, 12, {}, NUM_INTERFACES - 1 );
+  router.set_parallel( parallel );
+
+  // a few rounds, so that the workers are used more than once
+  for ( size_t start = 0; start < datagrams.size(); start += datagrams.size() / 3 ) {
+    for ( size_t j = start; j < min( datagrams.size(), start + datagrams.size() / 3 ); ++j ) {
+      router.interface( datagrams[j].first )->datagrams_received().push( clone( datagrams[j].second ) );
+    }
+    router.route();
+  }
+
+  vector<vector<string>> sent;
+  for ( const auto& port : ports ) {
+    sent.push_back( port->frames );
+  }
+  return sent;
+}
+
+// Parallel mode sends the same frames out of the same interfaces as serial mode: datagrams to every network
+// (and to nowhere), with TTLs that expire here, or don't
+void same_as_serial_test()
+{
+  default_random_engine rd { 38 };
+  vector<pair<size_t, InternetDatagram>> datagrams;
+  size_t forwardable = 0;
+  for ( size_t j = 0; j < NUM_DATAGRAMS; ++j ) {
+    InternetDatagram dgram;
+    switch ( rd() % 4 ) {
+      case 0:
+        dgram.header.dst = 0x0808'0808; // no route
+        break;
+      case 1:
+        dgram.header.dst = 0xac10'0000 | ( rd() % 16 ); // directly attached (via ARP)
+        break;
+      default:
+        dgram.header.dst = ip( rd() % NUM_INTERFACES, 7 + rd() % 100 ).ipv4_numeric();
+    }
+    dgram.header.ttl = static_cast<uint8_t>( rd() % 4 ); // 0 and 1 expire
+    dgram.header.src = 0xc0a8'0001;
+    dgram.payload.emplace_back( "datagram " + to_string( j ) );
+    dgram.header.len = IPv4Header::LENGTH + dgram.payload.front().get().size();
+    dgram.header.compute_checksum();
+
+    // (those to 172.16/12 wait for ARP replies that never come)
+    forwardable += ( dgram.header.dst >> 24 ) == 10 and dgram.header.ttl > 1;
+    datagrams.emplace_back( rd() % NUM_INTERFACES, move( dgram ) );
+  }
+
+  auto serial = route_all( datagrams, false );
+  auto parallel = route_all( datagrams, true );
+
+  size_t serial_datagrams = 0;
+  size_t serial_arp_requests = 0;
+  for ( size_t i = 0; i < NUM_INTERFACES; ++i ) {
+    // (the order in which different interfaces' datagrams reach the same output may differ)
+    ranges::sort( serial[i] );
+    ranges::sort( parallel[i] );
+    expect( serial[i] == parallel[i], "parallel mode sent different frames out of eth" + to_string( i ) );
+
+    for ( const auto& frame : serial[i] ) {
+      EthernetFrame parsed;
+      expect( parse( parsed, vector { frame } ), "sent an invalid frame" );
+      serial_datagrams += parsed.header.type == EthernetHeader::TYPE_IPv4;
+      serial_arp_requests += parsed.header.type == EthernetHeader::TYPE_ARP;
+    }
+  }
+  expect( serial_datagrams == forwardable,
+          "forwarded " + to_string( serial_datagrams ) + " datagrams instead of " + to_string( forwardable ) );
+  expect( serial_arp_requests == 16, "did not look up each directly attached destination once" );
+}
+
+// A route can only name an interface that exists
+void bad_route_test()
+{
+  Router router;
+  router.add_interface(
+    make_shared<NetworkInterface>( "eth0", make_shared<RecordingPort>(), ethernet( 0, 1 ), ip( 0, 1 ) ) );
+  router.add_route( 0, 0, {}, 0 );
+
+  bool threw = false;
+  try {
+    router.add_route( 0, 0, {}, 1 );
+  } catch ( const runtime_error& ) {
+    threw = true;
+  }
+  expect( threw, "accepted a route through an interface that doesn't exist" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    same_as_serial_test();
+    bad_route_test();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,519 @@
+#include "arp_message.hh"
+#include "helpers.hh"
+#include "router.hh"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+atomic<size_t> heap_allocations = 0; // counted by the replacement operator new below (from any thread)
+} // namespace
+
+void* operator new( size_t size )
+{
+  ++heap_allocations;
+  if ( void* ptr = malloc( size ) ) { // NOLINT(*-no-malloc, *-owning-memory)
+    return ptr;
+  }
+  throw bad_alloc {};
+}
+
+// (GCC sees the free() of memory from operator new, not that operator new itself calls malloc)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete( void* ptr ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+void operator delete( void* ptr, size_t /* size */ ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+#pragma GCC diagnostic pop
+
+namespace {
+constexpr size_t NUM_DATAGRAMS = 1'000'000;
+constexpr size_t BATCH_SIZE = 256;
+
+// An output port that only counts the frames (and payload bytes) it is given
+class CountingPort : public NetworkInterface::OutputPort
+{
+public:
+  size_t frames {};
+  size_t bytes {};
+  void transmit( const NetworkInterface& /* sender */, const EthernetFrame& frame ) override
+  {
+    ++frames;
+    for ( const auto& buf : frame.payload ) {
+      bytes += buf.get().size();
+    }
+  }
+};
+
+// Time `decrement` on a stream of headers (and check that it keeps the prototype's checksum valid)
+double ns_per_ttl_decrement( const IPv4Header& prototype, const auto& decrement )
+{
+  uint64_t sink = 0;
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < NUM_DATAGRAMS; ++i ) {
+    IPv4Header header = prototype;
+    header.ttl = static_cast<uint8_t>( 2 + i % 254 ); // (timing only: the checksum isn't kept valid here)
+    decrement( header );
+    sink += header.cksum;
+  }
+  const auto stop_time = steady_clock::now();
+
+  IPv4Header check = prototype;
+  decrement( check );
+  const uint16_t incremental = check.cksum;
+  check.compute_checksum();
+  if ( check.cksum != incremental or sink == 0 ) {
+    throw runtime_error( "TTL decrement produced the wrong checksum" );
+  }
+
+  return static_cast<double>( duration_cast<nanoseconds>( stop_time - start_time ).count() ) / NUM_DATAGRAMS;
+}
+
+void checksum_update_test( fstream& debug_output )
+{
+  IPv4Header prototype;
+  prototype.len = 84;
+  prototype.ttl = 64;
+  prototype.src = 0x0a000001;
+  prototype.dst = 0xc0a80102;
+  prototype.compute_checksum();
+
+  const double full_ns = ns_per_ttl_decrement( prototype, []( IPv4Header& h ) {
+    --h.ttl;
+    h.compute_checksum();
+  } );
+  const double incremental_ns = ns_per_ttl_decrement( prototype, []( IPv4Header& h ) { h.decrement_ttl(); } );
+
+  cout << "TTL decrement with full checksum: " << fixed << setprecision( 1 ) << full_ns
+       << " ns, with incremental (RFC 1624) update: " << incremental_ns << " ns\n";
+  debug_output << "      TTL decrement + checksum:  full " << fixed << setprecision( 1 ) << setw( 5 ) << full_ns
+               << " ns,  incremental " << setw( 5 ) << incremental_ns << " ns\n";
+
+  // on random headers, the incremental update must agree with a full recomputation
+  default_random_engine rd { 1624 };
+  for ( size_t i = 0; i < 100'000; ++i ) {
+    IPv4Header h = prototype;
+    h.ttl = static_cast<uint8_t>( 2 + rd() % 254 );
+    h.id = static_cast<uint16_t>( rd() );
+    h.src = static_cast<uint32_t>( rd() );
+    h.compute_checksum();
+    IPv4Header incremental = h;
+    incremental.decrement_ttl();
+    --h.ttl;
+    h.compute_checksum();
+    if ( h.cksum != incremental.cksum ) {
+      throw runtime_error( "incremental checksum disagrees with full recomputation" );
+    }
+  }
+}
+
+// Teach an interface a neighbor's Ethernet address (with an ARP reply)
+void learn( NetworkInterface& iface,
+            const EthernetAddress& iface_eth,
+            const Address& iface_ip,
+            const Address& neighbor,
+            const EthernetAddress& neighbor_eth )
+{
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = neighbor_eth;
+  arp.sender_ip_address = neighbor.ipv4_numeric();
+  arp.target_ethernet_address = iface_eth;
+  arp.target_ip_address = iface_ip.ipv4_numeric();
+  iface.recv_frame(
+    { .header = { .dst = iface_eth, .src = neighbor_eth, .type = EthernetHeader::TYPE_ARP },
+      .payload = serialize( arp ) } );
+}
+
+// A router with two interfaces, eth0 (10.0.0.1) and eth1 (192.168.1.1), that already knows the Ethernet
+// addresses of one neighbor on each: 10.0.0.2 and 192.168.1.2
+struct TwoPortRouter
+{
+  const array<EthernetAddress, 2> ethernet_addresses { { { 2, 0, 0, 0, 0, 1 }, { 2, 0, 0, 0, 0, 2 } } };
+  const array<Address, 2> ip_addresses { Address { "10.0.0.1" }, Address { "192.168.1.1" } };
+  shared_ptr<CountingPort> port0 = make_shared<CountingPort>();
+  shared_ptr<CountingPort> port1 = make_shared<CountingPort>();
+  Router router {};
+
+  TwoPortRouter()
+  {
+    router.add_interface( make_shared<NetworkInterface>( "eth0", port0, ethernet_addresses[0], ip_addresses[0] ) );
+    router.add_interface( make_shared<NetworkInterface>( "eth1", port1, ethernet_addresses[1], ip_addresses[1] ) );
+    learn( 0, Address { "10.0.0.2" }, { 2, 0, 0, 0, 0, 3 } );
+    learn( 1, Address { "192.168.1.2" }, { 2, 0, 0, 0, 0, 4 } );
+  }
+
+  void learn( size_t n, const Address& neighbor, const EthernetAddress& neighbor_eth )
+  {
+    ::learn( *router.interface( n ), ethernet_addresses.at( n ), ip_addresses.at( n ), neighbor, neighbor_eth );
+  }
+};
+
+InternetDatagram make_datagram( uint32_t dst )
+{
+  InternetDatagram dgram;
+  dgram.header.ttl = 64;
+  dgram.header.src = 0x0a000002;
+  dgram.header.dst = dst;
+  dgram.payload.emplace_back( string( 64, 'x' ) );
+  dgram.header.len = IPv4Header::LENGTH + 64;
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// Send datagrams to the given destinations (cycling through them) into eth0, and return the forwarding rate
+double forward( Router& router, const vector<InternetDatagram>& prototypes )
+{
+  auto& inbound = router.interface( 0 )->datagrams_received();
+
+  const auto start_time = steady_clock::now();
+  for ( size_t sent = 0; sent < NUM_DATAGRAMS; ) {
+    for ( size_t i = 0; i < BATCH_SIZE and sent < NUM_DATAGRAMS; ++i, ++sent ) {
+      inbound.push( clone( prototypes[sent % prototypes.size()] ) );
+    }
+    router.route();
+  }
+  const auto stop_time = steady_clock::now();
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  return static_cast<double>( NUM_DATAGRAMS ) / test_duration.count();
+}
+
+void forwarding_test( fstream& debug_output )
+{
+  TwoPortRouter r;
+  r.router.add_route( 0x0a000000, 8, {}, 0 );
+  r.router.add_route( 0xc0a80100, 24, {}, 1 );
+  r.router.add_route( 0, 0, Address { "192.168.1.2" }, 1 );
+
+  vector<InternetDatagram> prototypes;
+  prototypes.push_back( make_datagram( 0x08080808 ) ); // via the default route
+  const double packets_per_second = forward( r.router, prototypes );
+
+  if ( r.port1->frames != NUM_DATAGRAMS ) {
+    throw runtime_error( "router forwarded " + to_string( r.port1->frames ) + " of " + to_string( NUM_DATAGRAMS )
+                         + " datagrams" );
+  }
+
+  cout << "Router forwarded " << NUM_DATAGRAMS << " datagrams at " << fixed << setprecision( 0 )
+       << packets_per_second << " packets/s.\n";
+  debug_output << "      Router forwarding rate:    " << fixed << setprecision( 0 ) << setw( 9 )
+               << packets_per_second << " packets/s\n";
+
+  if ( packets_per_second < 100'000 ) {
+    throw runtime_error( "Router did not meet minimum rate of 100000 packets/s" );
+  }
+}
+
+// Sending a datagram to a known neighbor must not touch the heap (once the interface's reused frame has grown)
+void send_allocation_test( fstream& debug_output )
+{
+  const EthernetAddress eth { 2, 0, 0, 0, 0, 1 };
+  const Address ip { "10.0.0.1" };
+  const Address neighbor { "10.0.0.2" };
+  auto port = make_shared<CountingPort>();
+  NetworkInterface iface { "eth0", port, eth, ip };
+  learn( iface, eth, ip, neighbor, { 2, 0, 0, 0, 0, 2 } );
+
+  const InternetDatagram dgram = make_datagram( 0x08080808 );
+  iface.send_datagram( dgram, neighbor );
+
+  const size_t allocations_before = heap_allocations;
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < NUM_DATAGRAMS; ++i ) {
+    iface.send_datagram( dgram, neighbor );
+  }
+  const auto stop_time = steady_clock::now();
+  const size_t allocations = heap_allocations - allocations_before;
+
+  if ( port->frames != NUM_DATAGRAMS + 1 or port->bytes != port->frames * dgram.header.len ) {
+    throw runtime_error( "NetworkInterface sent the wrong frames" );
+  }
+
+  const double ns_per_send
+    = static_cast<double>( duration_cast<nanoseconds>( stop_time - start_time ).count() ) / NUM_DATAGRAMS;
+  cout << "NetworkInterface::send_datagram: " << fixed << setprecision( 1 ) << ns_per_send << " ns, "
+       << allocations << " heap allocations in " << NUM_DATAGRAMS << " sends.\n";
+  debug_output << "      send_datagram (ARP hit):   " << fixed << setprecision( 1 ) << setw( 9 ) << ns_per_send
+               << " ns\n";
+
+  if ( allocations != 0 ) {
+    throw runtime_error( "NetworkInterface::send_datagram allocated memory" );
+  }
+}
+
+// A datagram handed over by rvalue must keep its payload buffer all the way to the wire, even when it has to
+// wait for an ARP reply
+void queued_send_test()
+{
+  // an output port that remembers where the last frame's datagram payload lives
+  class PayloadPort : public NetworkInterface::OutputPort
+  {
+  public:
+    const char* payload {};
+    void transmit( const NetworkInterface& /* sender */, const EthernetFrame& frame ) override
+    {
+      payload = frame.payload.back().get().data();
+    }
+  };
+
+  const EthernetAddress eth { 2, 0, 0, 0, 0, 1 };
+  const Address ip { "10.0.0.1" };
+  const Address neighbor { "10.0.0.2" };
+  auto port = make_shared<PayloadPort>();
+  NetworkInterface iface { "eth0", port, eth, ip };
+
+  InternetDatagram dgram = make_datagram( 0x08080808 );
+  const char* const payload = dgram.payload.front().get().data();
+  iface.send_datagram( move( dgram ), neighbor ); // (sends an ARP request, and queues the datagram)
+  learn( iface, eth, ip, neighbor, { 2, 0, 0, 0, 0, 2 } );
+
+  if ( port->payload != payload ) {
+    throw runtime_error( "NetworkInterface copied the payload of a datagram it was given to queue" );
+  }
+}
+
+// The destination cache must count hits and misses, and must not outlive a change to the routing table
+void route_cache_test()
+{
+  TwoPortRouter r;
+  r.router.set_route_cache_size( 256 );
+  r.router.add_route( 0, 0, Address { "192.168.1.2" }, 1 );
+
+  auto& inbound = r.router.interface( 0 )->datagrams_received();
+  const auto send = [&]( uint32_t dst ) {
+    inbound.push( make_datagram( dst ) );
+    r.router.route();
+  };
+
+  for ( size_t i = 0; i < 100; ++i ) {
+    send( 0x08080808 );
+  }
+  if ( r.port1->frames != 100 or r.router.route_cache().hits() != 99 or r.router.route_cache().misses() != 1 ) {
+    throw runtime_error( "route cache: unexpected hit/miss counts" );
+  }
+
+  // a more specific route must take effect immediately
+  r.router.add_route( 0x08080800, 24, Address { "10.0.0.2" }, 0 );
+  send( 0x08080808 );
+  if ( r.port0->frames != 1 or r.router.route_cache().misses() != 2 ) {
+    throw runtime_error( "route cache was not invalidated by add_route" );
+  }
+}
+
+// Traffic to a few hundred destinations, through a large routing table, with and without the destination cache
+void skewed_forwarding_test( fstream& debug_output )
+{
+  constexpr size_t NUM_ROUTES = 100'000;
+  constexpr size_t NUM_DESTINATIONS = 300;
+
+  TwoPortRouter r;
+  default_random_engine rd { 37 };
+  uniform_int_distribution<uint32_t> address;
+  r.router.add_route( 0, 0, Address { "192.168.1.2" }, 1 );
+  for ( size_t i = 0; i < NUM_ROUTES; ++i ) {
+    r.router.add_route( address( rd ) & 0xffff'ff00, 24, Address { "192.168.1.2" }, 1 );
+  }
+
+  vector<InternetDatagram> prototypes;
+  for ( size_t i = 0; i < NUM_DESTINATIONS; ++i ) {
+    prototypes.push_back( make_datagram( address( rd ) ) );
+  }
+
+  const double uncached = forward( r.router, prototypes );
+  r.router.set_route_cache_size( 4096 );
+  const double cached = forward( r.router, prototypes );
+
+  const RouteCache& cache = r.router.route_cache();
+  const double hit_rate
+    = static_cast<double>( cache.hits() ) / static_cast<double>( cache.hits() + cache.misses() );
+
+  if ( r.port1->frames != 2 * NUM_DATAGRAMS ) {
+    throw runtime_error( "router did not forward every datagram" );
+  }
+
+  cout << "Router with " << NUM_ROUTES << " routes, " << NUM_DESTINATIONS << " destinations: " << fixed
+       << setprecision( 0 ) << uncached << " packets/s uncached, " << cached << " packets/s cached (hit rate "
+       << setprecision( 4 ) << hit_rate << ").\n";
+  debug_output << "      Router w/ route cache:     " << fixed << setprecision( 0 ) << setw( 9 ) << cached
+               << " packets/s (without: " << uncached << ")\n";
+
+  if ( hit_rate < 0.99 ) {
+    throw runtime_error( "route cache hit rate below 0.99 for " + to_string( NUM_DESTINATIONS ) + " destinations" );
+  }
+}
+
+// A router with `n` interfaces: interface i is 10.i.0.1, and reaches 10.i.0.0/16 through the neighbor 10.i.0.2.
+// Each interface receives datagrams for the next interface's network. Returns the forwarding rate, and the heap
+// allocations made by route() after the first round.
+pair<double, size_t> parallel_forwarding_rate( const size_t n, const bool parallel )
+{
+  const auto ip = [&]( size_t i, uint32_t host ) {
+    return Address::from_ipv4_numeric( 0x0a00'0000 | static_cast<uint32_t>( i ) << 16 | host );
+  };
+
+  Router router;
+  vector<shared_ptr<CountingPort>> ports;
+  vector<InternetDatagram> prototypes;
+  for ( size_t i = 0; i < n; ++i ) {
+    const EthernetAddress eth { 2, 0, 0, 0, static_cast<uint8_t>( i ), 1 };
+    const EthernetAddress neighbor_eth { 2, 0, 0, 0, static_cast<uint8_t>( i ), 2 };
+    ports.push_back( make_shared<CountingPort>() );
+    router.add_interface( make_shared<NetworkInterface>( "eth" + to_string( i ), ports.back(), eth, ip( i, 1 ) ) );
+    learn( *router.interface( i ), eth, ip( i, 1 ), ip( i, 2 ), neighbor_eth );
+    router.add_route( ip( i, 0 ).ipv4_numeric(), 16, ip( i, 2 ), i );
+    prototypes.push_back( make_datagram( ip( ( i + 1 ) % n, 7 ).ipv4_numeric() ) );
+  }
+  router.set_parallel( parallel );
+
+  const size_t rounds = NUM_DATAGRAMS / BATCH_SIZE / n;
+  size_t allocations = 0;
+  const auto start_time = steady_clock::now();
+  for ( size_t round = 0; round < rounds; ++round ) {
+    for ( size_t i = 0; i < n; ++i ) {
+      auto& inbound = router.interface( i )->datagrams_received();
+      for ( size_t j = 0; j < BATCH_SIZE; ++j ) {
+        inbound.push( clone( prototypes[i] ) );
+      }
+    }
+    const size_t allocations_before = heap_allocations;
+    router.route();
+    allocations += round > 0 ? heap_allocations - allocations_before : 0;
+  }
+  const auto stop_time = steady_clock::now();
+
+  for ( const auto& port : ports ) {
+    if ( port->frames != rounds * BATCH_SIZE ) {
+      throw runtime_error( "parallel router did not forward every datagram" );
+    }
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  return { static_cast<double>( rounds * BATCH_SIZE * n ) / test_duration.count(), allocations };
+}
+
+void parallel_forwarding_test( fstream& debug_output )
+{
+  for ( const size_t n : { 2, 4 } ) {
+    const auto [serial, serial_allocations] = parallel_forwarding_rate( n, false );
+    const auto [parallel, parallel_allocations] = parallel_forwarding_rate( n, true );
+
+    cout << "Router with " << n << " interfaces: " << fixed << setprecision( 0 ) << serial << " packets/s serial, "
+         << parallel << " packets/s with " << n << " worker threads (" << thread::hardware_concurrency()
+         << " cores), " << parallel_allocations << " heap allocations in route() after the first round.\n";
+    debug_output << "      Router, " << n << " workers:        " << fixed << setprecision( 0 ) << setw( 9 )
+                 << parallel << " packets/s (serial: " << serial << ")\n";
+
+    if ( parallel < 100'000 ) {
+      throw runtime_error( "parallel Router did not meet minimum rate of 100000 packets/s" );
+    }
+    if ( serial_allocations != 0 or parallel_allocations != 0 ) {
+      throw runtime_error( "Router allocated memory to forward datagrams" );
+    }
+  }
+}
+
+// One thread receives frames on eth0 while another routes them: the interface's receive ring (with a fixed
+// capacity) is the only thing the two share
+void threaded_receive_test( fstream& debug_output )
+{
+  constexpr size_t num_frames = 200'000;
+
+  TwoPortRouter r;
+  r.router.add_route( 0, 0, Address { "192.168.1.2" }, 1 );
+  NetworkInterface& eth0 = *r.router.interface( 0 );
+  auto& inbound = eth0.datagrams_received();
+  inbound.set_fixed_capacity( 1024 );
+
+  const InternetDatagram dgram = make_datagram( 0x08080808 );
+  const EthernetFrame prototype {
+    .header = { .dst = r.ethernet_addresses[0], .src = { 2, 0, 0, 0, 0, 3 }, .type = EthernetHeader::TYPE_IPv4 },
+    .payload = serialize( dgram ) };
+  vector<EthernetFrame> frames;
+  frames.reserve( num_frames );
+  for ( size_t i = 0; i < num_frames; ++i ) {
+    frames.push_back( clone( prototype ) ); // (the interface can only parse frames that own their payload)
+  }
+
+  const auto start_time = steady_clock::now();
+  jthread receiver { [&] {
+    for ( auto& frame : frames ) {
+      while ( inbound.size() == inbound.capacity() ) { // (like a NIC ring, but waiting rather than dropping)
+        this_thread::yield();
+      }
+      eth0.recv_frame( move( frame ) );
+    }
+  } };
+  while ( r.port1->frames < num_frames ) {
+    r.router.route();
+    if ( inbound.empty() ) {
+      this_thread::yield();
+    }
+  }
+  const auto stop_time = steady_clock::now();
+  receiver.join();
+
+  if ( r.port1->frames != num_frames or inbound.drops() != 0 ) {
+    throw runtime_error( "datagrams were lost between the receiving and routing threads" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const double packets_per_second = static_cast<double>( num_frames ) / test_duration.count();
+  cout << "Router forwarded " << num_frames << " datagrams received on another thread at " << fixed
+       << setprecision( 0 ) << packets_per_second << " packets/s.\n";
+  debug_output << "      Receive + route threads:   " << fixed << setprecision( 0 ) << setw( 9 )
+               << packets_per_second << " packets/s\n";
+
+  if ( packets_per_second < 100'000 ) {
+    throw runtime_error( "Router did not meet minimum rate of 100000 packets/s with a receiving thread" );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  checksum_update_test( debug_output );
+  forwarding_test( debug_output );
+  send_allocation_test( debug_output );
+  queued_send_test();
+  route_cache_test();
+  skewed_forwarding_test( debug_output );
+  parallel_forwarding_test( debug_output );
+  threaded_receive_test( debug_output );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
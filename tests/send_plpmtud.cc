@@ -0,0 +1,181 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    // Expect `count` segments of `size` bytes of `data`, from offset `begin` (which has seqno `seqno`)
+    const auto expect_segments = [&]( TCPSenderTestHarness& test,
+                                      const string& data,
+                                      size_t begin,
+                                      Wrap32 seqno,
+                                      size_t size,
+                                      size_t count ) {
+      for ( size_t i = 0; i < count; ++i ) {
+        test.execute( ExpectMessage {}
+                        .with_no_flags()
+                        .with_seqno( seqno + static_cast<uint32_t>( i * size ) )
+                        .with_data( data.substr( begin + i * size, size ) ) );
+      }
+    };
+
+    const auto random_string = [&]( size_t size ) {
+      string ret;
+      for ( size_t i = 0; i < size; ++i ) {
+        ret.push_back( static_cast<char>( 'a' + rd() % 26 ) );
+      }
+      return ret;
+    };
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Acknowledged probes raise the segment size", cfg };
+      test.execute( SetMaxPayloadSize { 200 } );
+      test.execute( EnablePLPMTUD { 1000 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 10000 ) );
+      test.execute( ExpectNoSegment {} );
+
+      // the first segment is a probe halfway between 200 and 1000 bytes
+      const string data = random_string( 4000 );
+      test.execute( Push { data.substr( 0, 2000 ) } );
+      expect_segments( test, data, 0, isn + 1, 600, 1 );
+      expect_segments( test, data, 600, isn + 601, 200, 7 );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectMaxPayloadSize { 200 } );
+      test.execute( AckReceived { isn + 2001 }.with_win( 10000 ) );
+      test.execute( ExpectMaxPayloadSize { 600 } );
+
+      // then halfway between 600 and 1000
+      test.execute( Push { data.substr( 2000 ) } );
+      expect_segments( test, data, 2000, isn + 2001, 800, 1 );
+      expect_segments( test, data, 2800, isn + 2801, 600, 2 );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { isn + 4001 }.with_win( 10000 ) );
+      test.execute( ExpectMaxPayloadSize { 800 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const uint16_t retx_timeout = uniform_int_distribution<uint16_t> { 10, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = retx_timeout;
+
+      TCPSenderTestHarness test { "Lost probes are resent in smaller segments, without backing off", cfg };
+      test.execute( SetMaxPayloadSize { 200 } );
+      test.execute( EnablePLPMTUD { 1000 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 10000 ) );
+
+      const string data = random_string( 4000 );
+      for ( unsigned i = 0; i < TCPSender::PLPMTUD_MAX_PROBES; ++i ) {
+        const Wrap32 seqno = isn + 1 + i * 1000;
+        test.execute( Push { data.substr( i * 1000, 1000 ) } );
+        expect_segments( test, data, i * 1000, seqno, 600, 1 );
+        expect_segments( test, data, i * 1000 + 600, seqno + 600, 200, 2 );
+        test.execute( Tick { retx_timeout - 1U } );
+        test.execute( ExpectNoSegment {} );
+        test.execute( Tick { 1 } );
+        expect_segments( test, data, i * 1000, seqno, 200, 3 );
+        test.execute( ExpectNoSegment {} );
+        test.execute( ExpectConsecutiveRetransmissions { 0 } );
+        test.execute( ExpectSeqnosInFlight { 1000 } );
+        test.execute( AckReceived { seqno + 1000 }.with_win( 10000 ) );
+        test.execute( ExpectMaxPayloadSize { 200 } );
+      }
+
+      // after PLPMTUD_MAX_PROBES losses, the search continues below the size that was lost
+      const Wrap32 seqno = isn + 1 + TCPSender::PLPMTUD_MAX_PROBES * 1000;
+      test.execute( Push { data.substr( 3000 ) } );
+      expect_segments( test, data, 3000, seqno, 400, 1 );
+      expect_segments( test, data, 3400, seqno + 400, 200, 3 );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const uint16_t retx_timeout = uniform_int_distribution<uint16_t> { 10, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = retx_timeout;
+
+      TCPSenderTestHarness test { "A known size is used at once, and the search resumes later", cfg };
+      test.execute( SetMaxPayloadSize { 200 } );
+      test.execute( EnablePLPMTUD { 1000, 600 } );
+      test.execute( ExpectMaxPayloadSize { 600 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 10000 ) );
+
+      const string data = random_string( 2000 );
+      test.execute( Push { data.substr( 0, 1000 ) } );
+      expect_segments( test, data, 0, isn + 1, 600, 1 );
+      expect_segments( test, data, 600, isn + 601, 400, 1 );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { isn + 1001 }.with_win( 10000 ) );
+
+      test.execute( Tick { TCPSender::PLPMTUD_RAISE_MS } );
+      test.execute( Push { data.substr( 1000 ) } );
+      expect_segments( test, data, 1000, isn + 1001, 800, 1 );
+      expect_segments( test, data, 1800, isn + 1801, 200, 1 );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const uint16_t retx_timeout = uniform_int_distribution<uint16_t> { 10, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = retx_timeout;
+
+      TCPSenderTestHarness test { "Segments that keep timing out fall back to the original size", cfg };
+      test.execute( SetMaxPayloadSize { 200 } );
+      test.execute( EnablePLPMTUD { 1000, 600 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 10000 ) );
+
+      const string data = random_string( 1600 );
+      test.execute( Push { data.substr( 0, 600 ) } );
+      expect_segments( test, data, 0, isn + 1, 600, 1 );
+      test.execute( Tick { retx_timeout } );
+      expect_segments( test, data, 0, isn + 1, 600, 1 );
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+
+      // the path got smaller: the segment is resent in pieces of the original size
+      test.execute( Tick { 2U * retx_timeout } );
+      expect_segments( test, data, 0, isn + 1, 200, 3 );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectMaxPayloadSize { 200 } );
+      test.execute( ExpectConsecutiveRetransmissions { 2 } );
+      test.execute( AckReceived { isn + 601 }.with_win( 10000 ) );
+
+      // and the search starts over, below the size that stopped working
+      test.execute( Push { data.substr( 600 ) } );
+      expect_segments( test, data, 600, isn + 601, 400, 1 );
+      expect_segments( test, data, 1000, isn + 1001, 200, 3 );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
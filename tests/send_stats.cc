@@ -0,0 +1,135 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const uint16_t retx_timeout = uniform_int_distribution<uint16_t> { 10, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.rt_timeout = retx_timeout;
+
+      TCPSenderTestHarness test { "Bytes and segments sent, retransmitted and acknowledged are counted", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( Push { "hello" } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "hello" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectStat { "segments_sent", &TCPSender::Stats::segments_sent, 2 } );
+      test.execute( ExpectStat { "bytes_sent", &TCPSender::Stats::bytes_sent, 5 } );
+      test.execute( ExpectStat { "bytes_acked", &TCPSender::Stats::bytes_acked, 0 } );
+
+      test.execute( Tick { retx_timeout } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "hello" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectStat { "segments_sent", &TCPSender::Stats::segments_sent, 3 } );
+      test.execute( ExpectStat { "bytes_sent", &TCPSender::Stats::bytes_sent, 10 } );
+      test.execute( ExpectStat { "retransmissions", &TCPSender::Stats::retransmissions, 1 } );
+      test.execute( ExpectStat { "bytes_retransmitted", &TCPSender::Stats::bytes_retransmitted, 5 } );
+
+      test.execute( AckReceived { isn + 6 } );
+      test.execute( ExpectStat { "bytes_acked", &TCPSender::Stats::bytes_acked, 5 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "The RTT is smoothed, and not sampled from retransmitted segments", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 30 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectStat { "rtt_samples", &TCPSender::Stats::rtt_samples, 1 } );
+      test.execute( ExpectStat { "srtt_us", &TCPSender::Stats::srtt_us, 30'000 } );
+      test.execute( ExpectStat { "rttvar_us", &TCPSender::Stats::rttvar_us, 15'000 } );
+
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { isn + 4 } );
+      test.execute( ExpectStat { "rtt_samples", &TCPSender::Stats::rtt_samples, 2 } );
+      test.execute( ExpectStat { "srtt_us", &TCPSender::Stats::srtt_us, ( 7 * 30'000 + 10'000 ) / 8 } );
+      test.execute( ExpectStat { "rttvar_us", &TCPSender::Stats::rttvar_us, ( 3 * 15'000 + 20'000 ) / 4 } );
+
+      test.execute( Push { "de" } );
+      test.execute( ExpectMessage {}.with_data( "de" ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_data( "de" ) );
+      test.execute( Tick { 5 } );
+      test.execute( AckReceived { isn + 6 } );
+      test.execute( ExpectStat { "rtt_samples", &TCPSender::Stats::rtt_samples, 2 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Duplicate ACKs are counted (but not ACKs that came with data)", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectStat { "dup_acks", &TCPSender::Stats::dup_acks, 0 } );
+
+      test.execute( Push { "abcdef" } );
+      test.execute( ExpectMessage {}.with_data( "abcdef" ) );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectStat { "dup_acks", &TCPSender::Stats::dup_acks, 2 } );
+      test.execute( AckReceived { isn + 1 }.with_data_in_segment() );
+      test.execute( ExpectStat { "dup_acks", &TCPSender::Stats::dup_acks, 2 } );
+      test.execute( AckReceived { isn + 1 }.with_win( 1000 ) );
+      test.execute( AckReceived { isn + 7 }.with_win( 1000 ) );
+      test.execute( ExpectStat { "dup_acks", &TCPSender::Stats::dup_acks, 2 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Time is split between window-limited and app-limited", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 3 ) );
+      test.execute( Push { "abcdefgh" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Tick { 50 } );
+      test.execute( ExpectStat { "window_limited_ms", &TCPSender::Stats::window_limited_ms, 50 } );
+
+      test.execute( AckReceived { isn + 4 }.with_win( 100 ) );
+      test.execute( ExpectMessage {}.with_data( "defgh" ) );
+      test.execute( Tick { 10 } );
+      test.execute( ExpectStat { "app_limited_ms", &TCPSender::Stats::app_limited_ms, 10 } );
+      test.execute( AckReceived { isn + 9 }.with_win( 100 ) );
+      test.execute( Tick { 20 } );
+      test.execute( ExpectStat { "window_limited_ms", &TCPSender::Stats::window_limited_ms, 50 } );
+      test.execute( ExpectStat { "app_limited_ms", &TCPSender::Stats::app_limited_ms, 30 } );
+
+      test.execute( Close {} );
+      test.execute( ExpectMessage {}.with_fin( true ) );
+      test.execute( Tick { 20 } );
+      test.execute( ExpectStat { "app_limited_ms", &TCPSender::Stats::app_limited_ms, 30 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
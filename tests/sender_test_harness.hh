@@ -129,6 +129,53 @@ struct HasError : public ExpectBool<TCPSender>
   bool value( const TCPSender& sender ) const override { return sender.writer().has_error(); }
 };
 
+struct SetMaxPayloadSize : public Action<TCPSender>
+{
+  size_t size_;
+
+  explicit SetMaxPayloadSize( size_t size ) : size_( size ) {}
+  std::string description() const override { return "set_max_payload_size(" + std::to_string( size_ ) + ")"; }
+  void execute( TCPSender& sender ) const override { sender.set_max_payload_size( size_ ); }
+};
+
+struct EnablePLPMTUD : public Action<TCPSender>
+{
+  size_t max_probe_payload_size_;
+  size_t initial_payload_size_;
+
+  explicit EnablePLPMTUD( size_t max_probe_payload_size, size_t initial_payload_size = 0 )
+    : max_probe_payload_size_( max_probe_payload_size ), initial_payload_size_( initial_payload_size )
+  {}
+  std::string description() const override
+  {
+    return "enable_plpmtud(" + std::to_string( max_probe_payload_size_ ) + ", "
+           + std::to_string( initial_payload_size_ ) + ")";
+  }
+  void execute( TCPSender& sender ) const override
+  {
+    sender.enable_plpmtud( max_probe_payload_size_, initial_payload_size_ );
+  }
+};
+
+struct ExpectMaxPayloadSize : public ExpectNumber<TCPSender, size_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "max_payload_size"; }
+  size_t value( const TCPSender& sender ) const override { return sender.max_payload_size(); }
+};
+
+struct ExpectStat : public ExpectNumber<TCPSender, uint64_t>
+{
+  std::string name_;
+  uint64_t TCPSender::Stats::* field_;
+
+  ExpectStat( std::string name, uint64_t TCPSender::Stats::* field, uint64_t value )
+    : ExpectNumber( value ), name_( std::move( name ) ), field_( field )
+  {}
+  std::string name() const override { return "stats()." + name_; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.stats().*field_; }
+};
+
 struct Push : public Action<SenderAndOutput>
 {
   std::string data_;
@@ -217,12 +264,14 @@ struct Receive : public Action<SenderAndOutput>
 {
   TCPReceiverMessage msg_;
   bool push_ = true;
+  bool carried_data_ = false;
 
   explicit Receive( TCPReceiverMessage msg ) : msg_( msg ) {}
   std::string description() const override
   {
     std::ostringstream desc;
-    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size << ")";
+    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size
+         << ( carried_data_ ? ", on a segment with data" : "" ) << ")";
     if ( push_ ) {
       desc << ", then push";
     }
@@ -235,9 +284,15 @@ struct Receive : public Action<SenderAndOutput>
     return *this;
   }
 
+  Receive& with_data_in_segment()
+  {
+    carried_data_ = true;
+    return *this;
+  }
+
   void execute( SenderAndOutput& ss ) const override
   {
-    ss.sender.receive( msg_ );
+    ss.sender.receive( msg_, carried_data_ );
     if ( push_ ) {
       ss.sender.push( ss.make_transmit() );
     }
@@ -0,0 +1,272 @@
+#include "helpers.hh"
+#include "tcp_listener.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+namespace {
+constexpr uint32_t SERVER_IP = 0x0a000001;       // 10.0.0.1
+constexpr uint32_t CLIENT_IP = 0x0a000002;       // 10.0.0.2
+constexpr uint32_t OTHER_CLIENT_IP = 0x0a000003; // 10.0.0.3
+constexpr uint16_t SERVER_PORT = 80;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "TCPListener: " + what );
+  }
+}
+
+// A TCPListener and some client TCPPeers, with the datagrams between them held until they are delivered
+class Network
+{
+public:
+  explicit Network( size_t backlog ) : listener_( cfg_, SERVER_IP, SERVER_PORT, backlog ) {}
+
+  TCPListener& listener() { return listener_; }
+
+  // A new client, which sends its SYN (to be delivered by to_server())
+  TCPPeer& connect( uint32_t ip, uint16_t port )
+  {
+    auto& client = clients_[{ ip, port }];
+    client = make_unique<TCPPeer>( cfg_ );
+    client->push( client_transmit( ip, port ) );
+    return *client;
+  }
+
+  // Let every client send what its application has written
+  void push_clients()
+  {
+    for ( auto& [address, client] : clients_ ) {
+      client->push( client_transmit( address.first, address.second ) );
+    }
+  }
+
+  // Let time pass for every client (e.g. so that one whose SYN was dropped sends it again)
+  void tick_clients( uint64_t ms )
+  {
+    for ( auto& [address, client] : clients_ ) {
+      client->tick( ms, client_transmit( address.first, address.second ) );
+    }
+  }
+
+  // Let time pass for the listener
+  void tick_server( uint64_t ms ) { listener_.tick( ms, server_transmit() ); }
+
+  // Deliver the datagrams on their way to the listener
+  void to_server()
+  {
+    while ( not to_server_.empty() ) {
+      listener_.receive( move( to_server_.front() ), server_transmit() );
+      to_server_.pop();
+    }
+  }
+
+  // Deliver the datagrams on their way to the clients
+  void to_clients()
+  {
+    while ( not to_clients_.empty() ) {
+      InternetDatagram dgram = move( to_clients_.front() );
+      to_clients_.pop();
+
+      TCPSegment seg;
+      expect( parse( seg, move( dgram.payload ), dgram.header.pseudo_checksum() ), "sent an invalid segment" );
+      const auto it = clients_.find( { dgram.header.dst, seg.udinfo.dst_port } );
+      expect( it != clients_.end(), "sent a segment to an unknown client" );
+      it->second->receive( move( seg.message ), client_transmit( dgram.header.dst, seg.udinfo.dst_port ) );
+    }
+  }
+
+  // Deliver datagrams both ways until there are none left
+  void exchange()
+  {
+    while ( not to_server_.empty() or not to_clients_.empty() ) {
+      to_server();
+      to_clients();
+    }
+  }
+
+  // Send the listener a datagram directly
+  void inject( const TCPMessage& msg, uint32_t ip, uint16_t port )
+  {
+    const UserDatagramInfo ports { .src_port = port, .dst_port = SERVER_PORT, .cksum = 0 };
+    to_server_.push( TCPOverIPv4Adapter::wrap_tcp_in_ip( msg, ip, SERVER_IP, ports ) );
+  }
+
+  size_t datagrams_to_clients() const { return to_clients_.size(); }
+
+private:
+  TCPPeer::TransmitFunction client_transmit( uint32_t ip, uint16_t port )
+  {
+    return [this, ip, port]( const TCPMessage& msg ) { inject( msg, ip, port ); };
+  }
+
+  TCPListener::TransmitFunction server_transmit()
+  {
+    return [this]( const InternetDatagram& dgram ) { to_clients_.push( clone( dgram ) ); };
+  }
+
+  TCPConfig cfg_ {};
+  TCPListener listener_;
+  map<pair<uint32_t, uint16_t>, unique_ptr<TCPPeer>> clients_ {};
+  queue<InternetDatagram> to_server_ {};
+  queue<InternetDatagram> to_clients_ {};
+};
+
+// A connection waits in the SYN queue during the handshake, and in the accept queue once it completes
+void handshake_test()
+{
+  Network net { TCPListener::DEFAULT_BACKLOG };
+  TCPListener& listener = net.listener();
+
+  net.connect( CLIENT_IP, 1000 );
+  net.to_server();
+  expect( listener.syn_queue_size() == 1 and listener.accept_queue_size() == 0, "SYN not in the SYN queue" );
+  expect( net.datagrams_to_clients() == 1, "did not answer a SYN" );
+  expect( listener.accept() == nullptr, "accepted a connection before its handshake completed" );
+
+  net.to_clients();
+  net.to_server();
+  expect( listener.syn_queue_size() == 0 and listener.accept_queue_size() == 1,
+          "connection not moved to the accept queue after the handshake" );
+
+  const auto conn = listener.accept();
+  expect( conn != nullptr and conn->established(), "did not accept an established connection" );
+  expect( conn->remote_ip() == CLIENT_IP and conn->remote_port() == 1000 and conn->local_ip() == SERVER_IP
+            and conn->local_port() == SERVER_PORT,
+          "accepted connection has the wrong addresses" );
+  expect( listener.accept_queue_size() == 0 and listener.accept() == nullptr, "accepted a connection twice" );
+
+  // a segment that isn't a SYN, for a connection the listener doesn't know, is ignored
+  TCPMessage stray;
+  stray.receiver->ackno = Wrap32 { 12345 };
+  net.inject( stray, CLIENT_IP, 2000 );
+  net.to_server();
+  expect( listener.connection_count() == 1 and net.datagrams_to_clients() == 0, "answered a stray segment" );
+}
+
+// Datagrams reach the connection for their (remote address, remote port, local address), and no other
+void demux_test()
+{
+  Network net { TCPListener::DEFAULT_BACKLOG };
+  TCPListener& listener = net.listener();
+
+  const array<pair<uint32_t, uint16_t>, 3> addresses {
+    { { CLIENT_IP, 1000 }, { CLIENT_IP, 1001 }, { OTHER_CLIENT_IP, 1000 } } };
+  map<pair<uint32_t, uint16_t>, TCPPeer*> clients;
+  for ( const auto& address : addresses ) {
+    clients[address] = &net.connect( address.first, address.second );
+  }
+  net.exchange();
+
+  map<pair<uint32_t, uint16_t>, shared_ptr<TCPListener::Connection>> connections;
+  while ( auto conn = listener.accept() ) {
+    connections[{ conn->remote_ip(), conn->remote_port() }] = conn;
+  }
+  expect( connections.size() == 3, "did not accept one connection per client" );
+
+  for ( auto& [address, client] : clients ) {
+    client->outbound_writer().push( "from " + to_string( address.first ) + ":" + to_string( address.second ) );
+  }
+  net.push_clients();
+  net.exchange();
+
+  for ( auto& [address, conn] : connections ) {
+    Reader& inbound = conn->peer().inbound_reader();
+    expect( inbound.peek() == "from " + to_string( address.first ) + ":" + to_string( address.second ),
+            "delivered data to the wrong connection" );
+    inbound.pop( inbound.bytes_buffered() );
+  }
+
+  // and in the other direction, only the client of the connection written to receives anything
+  connections.at( { CLIENT_IP, 1001 } )->peer().outbound_writer().push( "reply" );
+  listener.push( [&]( const InternetDatagram& dgram ) {
+    TCPSegment seg;
+    expect( parse( seg, clone( dgram ).payload, dgram.header.pseudo_checksum() ), "sent an invalid segment" );
+    expect( dgram.header.dst == CLIENT_IP and seg.udinfo.dst_port == 1001, "sent a reply to the wrong client" );
+  } );
+}
+
+// Each queue holds at most `backlog` connections; a SYN that doesn't fit is dropped (and counted)
+void backlog_test()
+{
+  Network net { 2 };
+  TCPListener& listener = net.listener();
+
+  net.connect( CLIENT_IP, 1000 );
+  net.connect( CLIENT_IP, 1001 );
+  net.connect( CLIENT_IP, 1002 );
+  net.to_server();
+  expect( listener.syn_queue_size() == 2 and listener.syns_dropped() == 1, "SYN queue overflowed its backlog" );
+  expect( listener.connection_count() == 2 and net.datagrams_to_clients() == 2, "answered a dropped SYN" );
+
+  // the two handshakes complete, and the accept queue is full
+  net.exchange();
+  expect( listener.syn_queue_size() == 0 and listener.accept_queue_size() == 2, "handshakes did not complete" );
+
+  // client 1002 sends its SYN again, but there is no room in the accept queue
+  net.tick_clients( TCPConfig::TIMEOUT_DFLT );
+  net.to_server();
+  expect( listener.syns_dropped() == 2 and listener.syn_queue_size() == 0, "accept queue overflowed its backlog" );
+
+  // once the application accepts a connection, there is room for it
+  expect( listener.accept() != nullptr, "did not accept a queued connection" );
+  net.tick_clients( TCPConfig::TIMEOUT_DFLT * 2 );
+  net.exchange();
+  expect( listener.syns_dropped() == 2 and listener.accept_queue_size() == 2,
+          "did not take a SYN there was room for" );
+}
+
+// A connection that is reset before the application accepts it gives up its place in the accept queue
+void reset_before_accept_test()
+{
+  Network net { 1 };
+  TCPListener& listener = net.listener();
+
+  net.connect( CLIENT_IP, 1000 );
+  net.exchange();
+  expect( listener.accept_queue_size() == 1, "handshake did not complete" );
+
+  TCPMessage rst;
+  rst.sender->RST = true;
+  net.inject( rst, CLIENT_IP, 1000 );
+  net.to_server();
+  net.tick_server( 1 );
+  expect( listener.accept_queue_size() == 0 and listener.connection_count() == 0,
+          "kept a reset connection in the accept queue" );
+
+  net.connect( CLIENT_IP, 1001 );
+  net.exchange();
+  expect( listener.syns_dropped() == 0 and listener.accept_queue_size() == 1,
+          "a reset connection still held its place in the backlog" );
+  expect( listener.accept() != nullptr, "did not accept the connection that took its place" );
+}
+} // namespace
+
+int main()
+{
+  try {
+    handshake_test();
+    demux_test();
+    backlog_test();
+    reset_before_accept_test();
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
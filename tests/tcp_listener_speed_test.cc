@@ -0,0 +1,154 @@
+#include "helpers.hh"
+#include "tcp_listener.hh"
+#include "tcp_over_ip.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+constexpr uint32_t SERVER_IP = 0x0a000001; // 10.0.0.1
+constexpr uint32_t CLIENT_IP = 0x0a000002; // 10.0.0.2
+constexpr uint16_t SERVER_PORT = 80;
+constexpr uint64_t RETRY_MS = uint64_t { TCPConfig::TIMEOUT_DFLT } << TCPConfig::MAX_RETX_ATTEMPTS;
+
+struct Client
+{
+  TCPPeer peer;
+  uint16_t port;
+};
+
+void speed_test( const size_t num_connections, // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t burst_size,      // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t backlog )
+{
+  TCPConfig cfg;
+  cfg.recv_capacity = cfg.send_capacity = 4096;
+
+  TCPListener listener { cfg, SERVER_IP, SERVER_PORT, backlog };
+  unordered_map<uint16_t, unique_ptr<Client>> clients;
+
+  queue<InternetDatagram> to_server;
+  queue<InternetDatagram> to_clients;
+  const auto server_transmit = [&]( const InternetDatagram& dgram ) { to_clients.push( clone( dgram ) ); };
+
+  size_t accepted = 0;
+  uint16_t next_port = 1024;
+
+  const auto start_time = steady_clock::now();
+
+  while ( accepted < num_connections ) {
+    // a burst of clients send their SYNs
+    for ( size_t i = 0; i < burst_size and accepted + clients.size() < num_connections; ++i ) {
+      auto client = make_unique<Client>( Client { TCPPeer { cfg }, next_port++ } );
+      const UserDatagramInfo ports { .src_port = client->port, .dst_port = SERVER_PORT, .cksum = 0 };
+      client->peer.push( [&]( const TCPMessage& msg ) {
+        to_server.push( TCPOverIPv4Adapter::wrap_tcp_in_ip( msg, CLIENT_IP, SERVER_IP, ports ) );
+      } );
+      clients.emplace( client->port, move( client ) );
+    }
+
+    // exchange datagrams until the network is quiet
+    while ( not to_server.empty() or not to_clients.empty() ) {
+      while ( not to_server.empty() ) {
+        listener.receive( move( to_server.front() ), server_transmit );
+        to_server.pop();
+      }
+
+      while ( not to_clients.empty() ) {
+        InternetDatagram dgram = move( to_clients.front() );
+        to_clients.pop();
+
+        TCPSegment seg;
+        if ( not parse( seg, move( dgram.payload ), dgram.header.pseudo_checksum() ) ) {
+          throw runtime_error( "client received invalid TCP segment" );
+        }
+
+        auto it = clients.find( seg.udinfo.dst_port );
+        if ( it == clients.end() ) {
+          continue;
+        }
+
+        Client& client = *it->second;
+        const UserDatagramInfo ports { .src_port = client.port, .dst_port = SERVER_PORT, .cksum = 0 };
+        client.peer.receive( move( seg.message ), [&]( const TCPMessage& msg ) {
+          to_server.push( TCPOverIPv4Adapter::wrap_tcp_in_ip( msg, CLIENT_IP, SERVER_IP, ports ) );
+        } );
+
+        if ( not client.peer.active() ) {
+          clients.erase( it );
+        }
+      }
+    }
+
+    // the application accepts every waiting connection, then aborts it (sending a RST)
+    while ( auto conn = listener.accept() ) {
+      if ( conn->remote_ip() != CLIENT_IP or not clients.contains( conn->remote_port() ) ) {
+        throw runtime_error( "accepted connection from unknown client" );
+      }
+      conn->peer().outbound_writer().set_error();
+      ++accepted;
+    }
+    listener.push( server_transmit );
+    listener.tick( 1, server_transmit );
+
+    // clients whose SYN was dropped (because the listener's queues were full) time out and retransmit it
+    for ( auto& [port, client] : clients ) {
+      const UserDatagramInfo ports { .src_port = port, .dst_port = SERVER_PORT, .cksum = 0 };
+      client->peer.tick( RETRY_MS, [&]( const TCPMessage& msg ) {
+        to_server.push( TCPOverIPv4Adapter::wrap_tcp_in_ip( msg, CLIENT_IP, SERVER_IP, ports ) );
+      } );
+    }
+  }
+
+  const auto stop_time = steady_clock::now();
+
+  if ( listener.syn_queue_size() != 0 or listener.accept_queue_size() != 0 ) {
+    throw runtime_error( "TCPListener queues not empty after all connections were accepted" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const auto connections_per_second = static_cast<double>( accepted ) / test_duration.count();
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "TCPListener with backlog=" << backlog << ", burst=" << burst_size << " accepted " << accepted
+       << " connections (" << listener.syns_dropped() << " SYNs dropped) at " << fixed << setprecision( 0 )
+       << connections_per_second << " connections/s.\n";
+
+  debug_output << "        TCPListener accept rate (burst " << setw( 4 ) << burst_size << "): " << fixed
+               << setprecision( 0 ) << setw( 8 ) << connections_per_second << " connections/s\n";
+
+  if ( connections_per_second < 1000 ) {
+    throw runtime_error( "TCPListener did not meet minimum rate of 1000 connections/s" );
+  }
+}
+
+void program_body()
+{
+  speed_test( 20000, 1, TCPListener::DEFAULT_BACKLOG );
+  speed_test( 20000, 100, TCPListener::DEFAULT_BACKLOG );
+  speed_test( 20000, 1000, TCPListener::DEFAULT_BACKLOG );
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
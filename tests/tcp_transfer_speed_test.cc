@@ -0,0 +1,261 @@
+#include "ipv4_header.hh"
+#include "link_emulator.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+constexpr uint64_t TIME_LIMIT_MS = 3600 * 1000; // of simulated time, for one transfer
+
+struct Scenario
+{
+  const char* name;
+  LinkConfig link; // (both directions; the downlink's seed is one more)
+  size_t megabytes;
+};
+
+// Watches the client's segments go out and the acknowledgments come back, to count retransmissions and sample
+// the round-trip time (following Karn's algorithm: not of segments sent before a retransmission was acked)
+class RTTMeter
+{
+public:
+  explicit RTTMeter( Wrap32 isn ) : isn_( isn ) {}
+
+  void sent( const TCPSenderMessage& msg, uint64_t now_ms )
+  {
+    if ( msg.sequence_length() == 0 ) {
+      return;
+    }
+    const uint64_t end = msg.seqno.unwrap( isn_, next_ ) + msg.sequence_length();
+    if ( end <= next_ ) {
+      ++retransmissions_;
+      karn_limit_ = next_;
+      return;
+    }
+    outstanding_.push_back( { end, now_ms } );
+    next_ = end;
+  }
+
+  void acknowledged( const TCPReceiverMessage& msg, uint64_t now_ms )
+  {
+    if ( not msg.ackno.has_value() ) {
+      return;
+    }
+    const uint64_t ackno = msg.ackno->unwrap( isn_, next_ );
+    while ( not outstanding_.empty() and outstanding_.front().end <= ackno ) {
+      if ( outstanding_.front().end > karn_limit_ ) {
+        samples_.push_back( now_ms - outstanding_.front().sent_ms );
+      }
+      outstanding_.pop_front();
+    }
+  }
+
+  // The `p`th percentile of the samples (in ms)
+  uint64_t percentile( unsigned p )
+  {
+    if ( samples_.empty() ) {
+      return 0;
+    }
+    const size_t index = ( samples_.size() - 1 ) * p / 100;
+    nth_element( samples_.begin(), samples_.begin() + static_cast<ptrdiff_t>( index ), samples_.end() );
+    return samples_[index];
+  }
+
+  uint64_t retransmissions() const { return retransmissions_; }
+
+private:
+  struct Segment
+  {
+    uint64_t end;
+    uint64_t sent_ms;
+  };
+
+  Wrap32 isn_;
+  uint64_t next_ {};
+  uint64_t karn_limit_ {};
+  uint64_t retransmissions_ {};
+  deque<Segment> outstanding_ {};
+  vector<uint64_t> samples_ {};
+};
+
+size_t wire_size( const TCPMessage& msg )
+{
+  return IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH + msg.sender->payload.size();
+}
+
+// Transfer `scenario.megabytes` of `block` (repeated) from a client TCPPeer to a server TCPPeer, over emulated
+// links in simulated time (a tick of 1 ms at a time), and check that the server's application reads it intact
+void transfer( const Scenario& scenario, const string& block, fstream& debug_output )
+{
+  const TCPConfig cfg;
+  TCPPeer client { cfg };
+  TCPPeer server { cfg };
+
+  LinkConfig downlink_config = scenario.link;
+  ++downlink_config.seed;
+  LinkEmulator<TCPMessage> uplink { scenario.link };
+  LinkEmulator<TCPMessage> downlink { downlink_config };
+
+  uint64_t now_ms = 0;
+  RTTMeter meter { cfg.isn };
+  const auto client_transmit = [&]( TCPMessage msg ) {
+    meter.sent( msg.sender.get(), now_ms );
+    uplink.send( clone( msg ), wire_size( msg ) );
+  };
+  const auto server_transmit = [&]( TCPMessage msg ) { downlink.send( clone( msg ), wire_size( msg ) ); };
+
+  const size_t total = scenario.megabytes * 1'000'000;
+  size_t written = 0;
+  size_t verified = 0;
+
+  // the server's application reads (and checks) whatever arrives as soon as it arrives
+  const auto read = [&] {
+    Reader& reader = server.inbound_reader();
+    while ( reader.bytes_buffered() > 0 ) {
+      const string_view data = reader.peek();
+      for ( size_t i = 0; i < data.size(); ) {
+        const size_t offset = ( verified + i ) % block.size();
+        const size_t len = min( data.size() - i, block.size() - offset );
+        if ( data.substr( i, len ) != string_view { block }.substr( offset, len ) ) {
+          throw runtime_error( "Mismatch between data written and read" );
+        }
+        i += len;
+      }
+      verified += data.size();
+      reader.pop( data.size() );
+    }
+  };
+
+  const auto start_time = steady_clock::now();
+  const clock_t start_cpu = clock();
+
+  while ( not server.inbound_reader().is_finished() ) {
+    // the client's application writes as much as the outbound stream takes
+    Writer& writer = client.outbound_writer();
+    while ( written < total and writer.available_capacity() > 0 ) {
+      const size_t offset = written % block.size();
+      const size_t len = min( { total - written, block.size() - offset, writer.available_capacity() } );
+      writer.push( block.substr( offset, len ) );
+      written += len;
+    }
+    if ( written == total and not writer.is_closed() ) {
+      writer.close();
+    }
+    client.push( client_transmit );
+
+    // the links deliver what has arrived
+    while ( auto msg = uplink.receive() ) {
+      server.receive( move( *msg ), server_transmit );
+      read();
+    }
+    while ( auto msg = downlink.receive() ) {
+      meter.acknowledged( msg->receiver.get(), now_ms );
+      client.receive( move( *msg ), client_transmit );
+    }
+
+    // time passes
+    ++now_ms;
+    uplink.tick( 1 );
+    downlink.tick( 1 );
+    client.tick( 1, client_transmit );
+    server.tick( 1, server_transmit );
+    if ( now_ms > TIME_LIMIT_MS or not client.active() ) {
+      throw runtime_error( string { scenario.name } + ": transfer did not finish" );
+    }
+  }
+
+  const clock_t stop_cpu = clock();
+  const auto stop_time = steady_clock::now();
+
+  if ( verified != total ) {
+    throw runtime_error( string { scenario.name } + ": " + to_string( verified ) + " of " + to_string( total )
+                         + " bytes arrived" );
+  }
+
+  const double goodput_mbps = static_cast<double>( total ) * 8 / static_cast<double>( now_ms ) / 1000;
+  const double cpu_seconds = static_cast<double>( stop_cpu - start_cpu ) / CLOCKS_PER_SEC;
+  const double cpu_ns_per_byte = cpu_seconds * 1e9 / static_cast<double>( total );
+  const double wall_seconds = duration_cast<duration<double>>( stop_time - start_time ).count();
+
+  cout << "TCP transfer (" << scenario.name << ") reached " << fixed << setprecision( 2 ) << goodput_mbps
+       << " Mbit/s goodput (" << meter.retransmissions() << " retransmissions, RTT p50/p90/p99 "
+       << meter.percentile( 50 ) << "/" << meter.percentile( 90 ) << "/" << meter.percentile( 99 ) << " ms, "
+       << cpu_ns_per_byte << " ns CPU/byte).\n";
+
+  debug_output << "     " << left << setw( 36 ) << scenario.name << right << fixed << setprecision( 2 ) << setw( 7 )
+               << goodput_mbps << " Mbit/s goodput, " << setw( 5 ) << meter.retransmissions() << " retx, RTT p50/"
+               << "p90/p99 " << meter.percentile( 50 ) << "/" << meter.percentile( 90 ) << "/"
+               << meter.percentile( 99 ) << " ms, " << setw( 5 ) << cpu_ns_per_byte << " ns CPU/byte ("
+               << setprecision( 1 ) << setw( 5 ) << static_cast<double>( now_ms ) / 1000 << " s simulated in "
+               << setprecision( 2 ) << wall_seconds << " s)\n";
+
+  // simulating the transfer takes at most 80 ns of CPU per byte: 0.1 Gbit/s
+  if ( cpu_ns_per_byte > 80 ) {
+    throw runtime_error( string { scenario.name } + ": TCP did not meet minimum speed of 0.1 Gbit/s." );
+  }
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  string block( 1 << 16, 0 );
+  default_random_engine rd { 4246 };
+  uniform_int_distribution<char> byte_dist;
+  for ( auto& ch : block ) {
+    ch = byte_dist( rd );
+  }
+
+  const vector<Scenario> scenarios {
+    { .name = "no bandwidth limit, 10 ms delay", .link = { .delay_ms = 10, .seed = 1 }, .megabytes = 16 },
+    { .name = "100 Mbit/s, 10 ms, 100-packet queue",
+      .link = { .rate_bytes_per_s = 12'500'000, .queue_limit = 100, .delay_ms = 10, .seed = 2 },
+      .megabytes = 16 },
+    { .name = "10 Mbit/s, 10 ms, 20-packet queue",
+      .link = { .rate_bytes_per_s = 1'250'000, .queue_limit = 20, .delay_ms = 10, .seed = 3 },
+      .megabytes = 1 },
+    { .name = "1% loss, 10 +/- 2 ms delay",
+      .link = { .delay_ms = 10, .jitter_ms = 2, .loss_good = 0.01, .seed = 4 },
+      .megabytes = 4 },
+    { .name = "bursty loss, 10 ms delay",
+      .link = { .delay_ms = 10, .loss_bad = 0.5, .good_to_bad = 0.002, .bad_to_good = 0.2, .seed = 5 },
+      .megabytes = 4 },
+  };
+
+  for ( const auto& scenario : scenarios ) {
+    transfer( scenario, block, debug_output );
+  }
+}
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
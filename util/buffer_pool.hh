@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+//! \brief A freelist of fixed-size "slabs" to read packets into
+//! \details acquire() hands out a Slab of slab_size() bytes, reusing a free one if possible, so reading a packet
+//! doesn't have to allocate (and zero) a fresh buffer. A Slab owns its bytes until it is destroyed, and then
+//! goes back to the freelist by itself (if the pool still exists and isn't full), so whatever is parsed out of
+//! it has to be done by then.
+class BufferPool
+{
+  struct State
+  {
+    size_t slab_size;
+    size_t max_free;
+    std::vector<std::string> free {};
+    uint64_t allocations {};
+    uint64_t reuses {};
+  };
+
+  std::shared_ptr<State> state_;
+
+public:
+  static constexpr size_t DEFAULT_MAX_FREE = 64; //!< Default number of idle slabs to keep
+
+  //! A slab of bytes, on loan from a BufferPool until it is destroyed
+  class Slab
+  {
+    std::string bytes_;
+    std::weak_ptr<State> pool_;
+
+  public:
+    Slab( std::string&& bytes, std::weak_ptr<State> pool )
+      : bytes_( std::move( bytes ) ), pool_( std::move( pool ) )
+    {}
+
+    Slab( Slab&& other ) noexcept = default;
+    Slab( const Slab& other ) = delete;
+    Slab& operator=( const Slab& other ) = delete;
+    Slab& operator=( Slab&& other ) = delete;
+
+    ~Slab()
+    {
+      const std::shared_ptr<State> pool = pool_.lock();
+      if ( pool and bytes_.size() == pool->slab_size and pool->free.size() < pool->max_free ) {
+        pool->free.push_back( std::move( bytes_ ) );
+      }
+    }
+
+    //! The whole slab, to read into (contents unspecified)
+    std::span<char> span() { return bytes_; }
+
+    //! The first `len` bytes of the slab
+    std::string_view view( size_t len ) const { return std::string_view { bytes_ }.substr( 0, len ); }
+  };
+
+  explicit BufferPool( size_t slab_size, size_t max_free = DEFAULT_MAX_FREE )
+    : state_( std::make_shared<State>( State { .slab_size = slab_size, .max_free = max_free } ) )
+  {}
+
+  //! A Slab of slab_size() bytes (contents unspecified), which returns to this pool when it is destroyed
+  Slab acquire()
+  {
+    if ( state_->free.empty() ) {
+      ++state_->allocations;
+      return { std::string( state_->slab_size, 0 ), state_ };
+    }
+
+    ++state_->reuses;
+    std::string bytes = std::move( state_->free.back() );
+    state_->free.pop_back();
+    return { std::move( bytes ), state_ };
+  }
+
+  // Accessors
+  size_t slab_size() const { return state_->slab_size; }
+  size_t free_count() const { return state_->free.size(); }
+  uint64_t allocations() const { return state_->allocations; } // slabs that had to be allocated
+  uint64_t reuses() const { return state_->reuses; }           // slabs that came from the freelist
+};
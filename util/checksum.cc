@@ -0,0 +1,149 @@
+#include "checksum.hh"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#if defined( __x86_64__ )
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+// Fold a 64-bit one's-complement sum down to 16 bits
+uint16_t fold( uint64_t sum )
+{
+  sum = ( sum >> 32 ) + ( sum & 0xffff'ffff );
+  sum = ( sum >> 32 ) + ( sum & 0xffff'ffff );
+  sum = ( sum >> 16 ) + ( sum & 0xffff );
+  sum = ( sum >> 16 ) + ( sum & 0xffff );
+  return static_cast<uint16_t>( sum );
+}
+
+// One's-complement sum of 16-bit words in host byte order: add eight bytes at a time, with end-around carry.
+// (The one's-complement sum commutes with byte swapping, so the words can be summed in any byte order and
+// swapped once at the end.)
+uint64_t sum_scalar( const char* data, size_t len )
+{
+  uint64_t sum = 0;
+  for ( ; len >= 8; data += 8, len -= 8 ) {
+    uint64_t word {};
+    memcpy( &word, data, sizeof( word ) );
+    sum += word;
+    sum += ( sum < word ); // end-around carry
+  }
+
+  uint64_t tail = 0;
+  memcpy( &tail, data, len ); // the 0-7 remaining bytes, in the same lanes they would have had in a full word
+  sum += tail;
+  sum += ( sum < tail );
+  return sum;
+}
+
+#if defined( __x86_64__ )
+// Same sum, 32 bytes at a time: widen each 32-bit word to a 64-bit lane so that the adds can't overflow.
+__attribute__( ( target( "avx2" ) ) ) uint64_t sum_avx2( const char* data, size_t len )
+{
+  __m256i acc0 = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+
+  // each lane gains less than 2^32 per iteration, so it can't overflow for buffers below 2^32 * 32 bytes
+  for ( ; len >= 32; data += 32, len -= 32 ) {
+    const __m128i lo = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) );        // NOLINT
+    const __m128i hi = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + 16 ) );   // NOLINT
+    acc0 = _mm256_add_epi64( acc0, _mm256_cvtepu32_epi64( lo ) );
+    acc1 = _mm256_add_epi64( acc1, _mm256_cvtepu32_epi64( hi ) );
+  }
+
+  alignas( 32 ) array<uint64_t, 4> lanes {};
+  _mm256_store_si256( reinterpret_cast<__m256i*>( lanes.data() ), _mm256_add_epi64( acc0, acc1 ) ); // NOLINT
+
+  // fold each lane before combining them, so the combination can't overflow either
+  uint64_t sum = sum_scalar( data, len );
+  for ( const uint64_t lane : lanes ) {
+    sum += fold( lane );
+  }
+  return sum;
+}
+#endif
+
+using SumFunction = uint64_t ( * )( const char*, size_t );
+
+SumFunction choose_sum_function()
+{
+#if defined( __x86_64__ )
+  if ( __builtin_cpu_supports( "avx2" ) ) {
+    return sum_avx2;
+  }
+#endif
+  return sum_scalar;
+}
+} // namespace
+
+void InternetChecksum::add( string_view data )
+{
+  if ( data.empty() ) {
+    return;
+  }
+
+  // finish the 16-bit word begun by the previous (odd-length) chunk
+  if ( parity_ ) {
+    sum_ += static_cast<uint8_t>( data.front() );
+    data.remove_prefix( 1 );
+    parity_ = false;
+  }
+
+  // an odd byte at the end begins a new 16-bit word (as its high-order byte)
+  const bool odd = data.size() % 2;
+  const size_t even_length = data.size() - odd;
+
+  static const SumFunction sum_words = choose_sum_function();
+  uint16_t words = fold( sum_words( data.data(), even_length ) );
+  if constexpr ( endian::native == endian::little ) {
+    words = __builtin_bswap16( words );
+  }
+
+  // keep the running sum small (its end-around carries are folded again by value())
+  sum_ = ( sum_ >> 16 ) + ( sum_ & 0xffff ) + words;
+
+  if ( odd ) {
+    sum_ += static_cast<uint32_t>( static_cast<uint8_t>( data.back() ) ) << 8;
+    parity_ = true;
+  }
+}
+
+//! \details The data is copied in blocks small enough to stay in the L1 cache, and each block is summed from
+//! its new location right after being copied, so the source is only read from memory once.
+void InternetChecksum::append_and_add( string& out, string_view data )
+{
+  constexpr size_t BLOCK_SIZE = 4096;
+
+  while ( not data.empty() ) {
+    const string_view block = data.substr( 0, BLOCK_SIZE );
+    const size_t offset = out.size();
+    out.append( block );
+    add( string_view { out }.substr( offset ) );
+    data.remove_prefix( block.size() );
+  }
+}
+
+//! \details Like append_and_add(), a block at a time. Throws if `out` is too small.
+void InternetChecksum::copy_and_add( span<char> out, string_view data )
+{
+  constexpr size_t BLOCK_SIZE = 4096;
+
+  if ( out.size() < data.size() ) {
+    throw runtime_error( "InternetChecksum::copy_and_add: output too small" );
+  }
+
+  while ( not data.empty() ) {
+    const string_view block = data.substr( 0, BLOCK_SIZE );
+    memcpy( out.data(), block.data(), block.size() );
+    add( string_view { out.data(), block.size() } );
+    out = out.subspan( block.size() );
+    data.remove_prefix( block.size() );
+  }
+}
@@ -2,6 +2,9 @@
 
 #include <cstdint>
 #include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
 
 //! The internet checksum algorithm
 class InternetChecksum
@@ -12,17 +15,16 @@ private:
 
 public:
   explicit InternetChecksum( const uint32_t sum = 0 ) : sum_( sum ) {}
-  void add( std::string_view data )
-  {
-    for ( const uint8_t i : data ) {
-      uint16_t val = i;
-      if ( not parity_ ) {
-        val <<= 8;
-      }
-      sum_ += val;
-      parity_ = !parity_;
-    }
-  }
+
+  //! Add a chunk of data (which may have an odd length, and may continue where an odd-length chunk left off)
+  //! \details Sums eight bytes at a time (or 32 with AVX2, if the CPU has it) rather than byte by byte.
+  void add( std::string_view data );
+
+  //! Append `data` to `out` and add it to the checksum, making a single pass over `data`
+  void append_and_add( std::string& out, std::string_view data );
+
+  //! Copy `data` into the first data.size() bytes of `out` and add it to the checksum, in a single pass
+  void copy_and_add( std::span<char> out, std::string_view data );
 
   uint16_t value() const
   {
@@ -35,6 +37,16 @@ public:
     return ~ret;
   }
 
+  //! Update a checksum after one 16-bit word of the data it covers changes from `old_word` to `new_word`,
+  //! without re-summing the data ([RFC 1624](\ref rfc::rfc1624), eqn. 3: HC' = ~(~HC + ~m + m'))
+  static uint16_t adjust( const uint16_t checksum, const uint16_t old_word, const uint16_t new_word )
+  {
+    uint32_t sum = static_cast<uint16_t>( ~checksum ) + static_cast<uint16_t>( ~old_word ) + new_word;
+    sum = ( sum >> 16 ) + ( sum & 0xffff );
+    sum = ( sum >> 16 ) + ( sum & 0xffff );
+    return static_cast<uint16_t>( ~sum );
+  }
+
   void add( std::ranges::range auto&& data )
   {
     for ( const auto& x : data ) {
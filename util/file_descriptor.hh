@@ -3,6 +3,8 @@
 #include "ref.hh"
 #include <cstddef>
 #include <memory>
+#include <span>
+#include <string>
 #include <vector>
 
 // A reference-counted handle to a file descriptor
@@ -63,10 +65,11 @@ public:
 
   // Read into `buffer`
   void read( std::string& buffer );
+  size_t read( std::span<char> buffer ); // returns the number of bytes read (0 at EOF, or if it would block)
   void read( std::vector<std::string>& buffers );
 
   // Attempt to write a buffer
-  // returns number of bytes written
+  // returns number of bytes written (0 if the fd is non-blocking and would block)
   size_t write( std::string_view buffer );
   size_t write( const std::vector<std::string_view>& buffers );
   size_t write( const std::vector<Ref<std::string>>& buffers );
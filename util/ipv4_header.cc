@@ -2,6 +2,7 @@
 #include "checksum.hh"
 
 #include <arpa/inet.h>
+#include <array>
 #include <sstream>
 
 using namespace std;
@@ -105,15 +106,26 @@ uint32_t IPv4Header::pseudo_checksum() const
 void IPv4Header::compute_checksum()
 {
   cksum = 0;
-  Serializer s;
+  array<char, LENGTH> arena {};
+  Serializer s { arena };
   serialize( s );
 
   // calculate checksum -- taken over header only
   InternetChecksum check;
-  check.add( s.finish() );
+  check.add( string_view { arena.data(), arena.size() } );
   cksum = check.value();
 }
 
+//! \details The TTL shares a 16-bit word of the header with the protocol field, so only that word's
+//! contribution to the checksum has to change ([RFC 1624](\ref rfc::rfc1624)).
+void IPv4Header::decrement_ttl()
+{
+  const uint16_t old_word = static_cast<uint16_t>( ttl << 8 | proto );
+  --ttl;
+  const uint16_t new_word = static_cast<uint16_t>( ttl << 8 | proto );
+  cksum = InternetChecksum::adjust( cksum, old_word, new_word );
+}
+
 string IPv4Header::to_string() const
 {
   stringstream ss {};
@@ -1,7 +1,6 @@
 #pragma once
 
 #include "parser.hh"
-#include ""
 
 #include <cstddef>
 #include <cstdint>
@@ -58,6 +57,9 @@ struct IPv4Header
   // Set checksum to correct value
   void compute_checksum();
 
+  // Decrement the TTL, updating the checksum incrementally (it must have been correct beforehand)
+  void decrement_ttl();
+
   // Return a string containing a header in human-readable format
   std::string to_string() const;
 
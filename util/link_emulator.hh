@@ -0,0 +1,219 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+//! Settings for a LinkEmulator (after Linux's netem and tbf queueing disciplines)
+struct LinkConfig
+{
+  uint64_t rate_bytes_per_s = 0; //!< Bandwidth of the link (0: unlimited)
+  size_t burst_bytes = 0;        //!< Bytes that may leave at once after an idle period (the token bucket depth)
+  size_t queue_limit = 0;        //!< Packets that may wait for the link (0: unlimited); more are dropped
+
+  uint64_t delay_ms = 0;  //!< Propagation delay
+  uint64_t jitter_ms = 0; //!< Each packet's delay varies by up to this much either way (which may reorder them)
+  double reorder = 0;     //!< Probability that a packet skips the delay, overtaking the packets sent before it
+  double duplicate = 0;   //!< Probability that a packet arrives twice
+
+  //! \name Gilbert-Elliott loss
+  //! The link is in a good or a bad state, and loses packets with a different probability in each. (Uniform loss:
+  //! set only loss_good. Gilbert's bursty loss: set good_to_bad and bad_to_good, and loss_bad = 1.)
+  //!@{
+  double loss_good = 0;   //!< Probability of losing a packet in the good state
+  double loss_bad = 0;    //!< Probability of losing a packet in the bad state
+  double good_to_bad = 0; //!< Probability of going from the good state to the bad one, per packet
+  double bad_to_good = 1; //!< Probability of going from the bad state back to the good one, per packet
+  //!@}
+
+  uint64_t seed = 0; //!< Seed of the random choices (the same seed and inputs give the same results)
+};
+
+//! \brief A one-way link with limited bandwidth, delay, jitter, reordering, duplication and bursty loss
+//! \details Packets wait in a FIFO queue for a token bucket (tail-dropped when the queue is full), then each is
+//! lost, delayed, or duplicated at random, and arrives at the other end once the clock passes its arrival time.
+//! The clock only moves with tick(), so an emulated link is deterministic: the same seed and the same sequence
+//! of calls give the same results, whatever the real time. Lost packets still used up their share of the
+//! bandwidth (they are lost after the bottleneck).
+template<class T>
+class LinkEmulator
+{
+public:
+  struct Stats
+  {
+    uint64_t sent {};        //!< Packets given to send()
+    uint64_t delivered {};   //!< Packets returned by receive() (including duplicates)
+    uint64_t queue_drops {}; //!< Packets dropped because the queue was full
+    uint64_t lost {};        //!< Packets lost on the link
+    uint64_t duplicated {};  //!< Extra copies made
+    uint64_t reordered {};   //!< Packets that skipped the delay
+  };
+
+  explicit LinkEmulator( const LinkConfig& config = {} )
+    : config_( config ), rng_( config.seed ), tokens_( config.burst_bytes * MICROS_PER_SECOND )
+  {}
+
+  //! Send a packet of `bytes` bytes at the current time. Returns false if it was dropped or lost.
+  bool send( T packet, size_t bytes )
+  {
+    ++stats_.sent;
+
+    while ( not departures_.empty() and departures_.front() <= now_us_ ) {
+      departures_.pop_front();
+    }
+    if ( config_.queue_limit != 0 and departures_.size() >= config_.queue_limit ) {
+      ++stats_.queue_drops;
+      return false;
+    }
+
+    const uint64_t departure = depart( bytes );
+    departures_.push_back( departure );
+
+    if ( lose() ) {
+      ++stats_.lost;
+      return false;
+    }
+
+    if ( chance( config_.duplicate ) ) {
+      ++stats_.duplicated;
+      schedule( copy_of( packet ), departure );
+    }
+    schedule( std::move( packet ), departure );
+    return true;
+  }
+
+  //! Advance the clock
+  void tick( uint64_t ms_since_last_tick ) { now_us_ += ms_since_last_tick * MICROS_PER_MILLI; }
+
+  //! The next packet that has arrived by now, if any (in order of arrival)
+  std::optional<T> receive()
+  {
+    if ( in_flight_.empty() or in_flight_.front().arrival > now_us_ ) {
+      return {};
+    }
+    std::pop_heap( in_flight_.begin(), in_flight_.end(), later );
+    T packet = std::move( in_flight_.back().packet );
+    in_flight_.pop_back();
+    ++stats_.delivered;
+    return packet;
+  }
+
+  //! When the next packet arrives (to skip idle time), if any is on its way
+  std::optional<uint64_t> next_arrival_ms() const
+  {
+    if ( in_flight_.empty() ) {
+      return {};
+    }
+    return ( in_flight_.front().arrival + MICROS_PER_MILLI - 1 ) / MICROS_PER_MILLI;
+  }
+
+  // Accessors
+  uint64_t now_ms() const { return now_us_ / MICROS_PER_MILLI; }
+  size_t in_flight() const { return in_flight_.size(); } //!< Packets sent (or copied) but not received yet
+  const LinkConfig& config() const { return config_; }
+  const Stats& stats() const { return stats_; }
+
+private:
+  static constexpr uint64_t MICROS_PER_MILLI = 1000;
+  static constexpr uint64_t MICROS_PER_SECOND = 1000 * 1000;
+
+  struct InFlight
+  {
+    uint64_t arrival;
+    uint64_t serial; // (packets that arrive at the same time stay in order)
+    T packet;
+  };
+
+  static bool later( const InFlight& a, const InFlight& b )
+  {
+    return a.arrival != b.arrival ? a.arrival > b.arrival : a.serial > b.serial;
+  }
+
+  static T copy_of( const T& packet )
+  {
+    if constexpr ( requires { clone( packet ); } ) {
+      return clone( packet );
+    } else {
+      return T { packet };
+    }
+  }
+
+  // When a packet of `bytes` bytes leaves the token bucket: tokens are counted in millionths of a byte, and
+  // accrue at rate_bytes_per_s per microsecond up to the bucket's depth (at least one packet)
+  uint64_t depart( size_t bytes )
+  {
+    const uint64_t rate = config_.rate_bytes_per_s;
+    const uint64_t start = std::max( now_us_, last_departure_ );
+    if ( rate == 0 ) {
+      last_departure_ = start;
+      return start;
+    }
+
+    const uint64_t depth = std::max( config_.burst_bytes, bytes ) * MICROS_PER_SECOND;
+    const uint64_t elapsed = start - tokens_at_;
+    const uint64_t missing = depth - std::min( tokens_, depth );
+    tokens_ = elapsed > missing / rate ? depth : std::min( depth, tokens_ + elapsed * rate ); // (no overflow)
+
+    const uint64_t cost = bytes * MICROS_PER_SECOND;
+    uint64_t departure = start;
+    if ( tokens_ < cost ) {
+      const uint64_t wait = ( cost - tokens_ + rate - 1 ) / rate;
+      departure += wait;
+      tokens_ += wait * rate;
+    }
+    tokens_ -= cost;
+    tokens_at_ = departure;
+    last_departure_ = departure;
+    return departure;
+  }
+
+  // Move between the good and bad states, then lose the packet with the state's probability
+  bool lose()
+  {
+    bad_ = bad_ ? not chance( config_.bad_to_good ) : chance( config_.good_to_bad );
+    return chance( bad_ ? config_.loss_bad : config_.loss_good );
+  }
+
+  void schedule( T&& packet, const uint64_t departure )
+  {
+    uint64_t arrival = departure;
+    if ( chance( config_.reorder ) ) {
+      ++stats_.reordered;
+    } else {
+      arrival += config_.delay_ms * MICROS_PER_MILLI;
+      if ( config_.jitter_ms != 0 ) {
+        const auto jitter = static_cast<int64_t>( config_.jitter_ms * MICROS_PER_MILLI );
+        const int64_t offset = std::uniform_int_distribution<int64_t> { -jitter, jitter }( rng_ );
+        arrival = offset < 0 ? arrival - std::min( arrival - departure, static_cast<uint64_t>( -offset ) )
+                             : arrival + static_cast<uint64_t>( offset );
+      }
+    }
+
+    in_flight_.push_back( { arrival, next_serial_++, std::move( packet ) } );
+    std::push_heap( in_flight_.begin(), in_flight_.end(), later );
+  }
+
+  bool chance( double probability )
+  {
+    return probability > 0 and std::uniform_real_distribution<double> { 0, 1 }( rng_ ) < probability;
+  }
+
+  LinkConfig config_;
+  std::mt19937_64 rng_;
+  uint64_t now_us_ {};
+
+  uint64_t tokens_;
+  uint64_t tokens_at_ {};
+  uint64_t last_departure_ {};
+  std::deque<uint64_t> departures_ {}; // of the packets still waiting for the link
+
+  bool bad_ {};
+  std::vector<InFlight> in_flight_ {}; // a heap, soonest arrival first
+  uint64_t next_serial_ {};
+  Stats stats_ {};
+};
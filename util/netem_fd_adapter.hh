@@ -0,0 +1,85 @@
+#pragma once
+
+#include "file_descriptor.hh"
+#include "ipv4_header.hh"
+#include "link_emulator.hh"
+#include "tcp_config.hh"
+#include "tcp_segment.hh"
+
+#include <optional>
+#include <utility>
+
+//! \brief An adapter that sends the segments written to an FD adapter over an emulated link (see LinkEmulator)
+//! \details Each segment written is held until the emulated link delivers it (or drops it), and is then written
+//! to the underlying adapter from tick(), so the socket's clock drives the link. Only the outbound direction is
+//! emulated: segments are read as soon as the file descriptor is readable, so they can't be held back. To
+//! impair both directions, emulate the uplink at both ends.
+template<typename AdapterT>
+class NetemFdAdapter
+{
+private:
+  //! The underlying FD adapter
+  AdapterT _adapter;
+
+  //! The emulated link for outbound segments
+  LinkEmulator<TCPMessage> _uplink;
+
+  //! Write the segments that have arrived at the other end of the link
+  void _deliver()
+  {
+    while ( auto seg = _uplink.receive() ) {
+      _adapter.write( seg.value() );
+    }
+  }
+
+public:
+  //! Conversion to a FileDescriptor by returning the underlying AdapterT
+  FileDescriptor& fd() { return _adapter.fd(); }
+
+  //! Construct from the adapter to send through, and the settings of the emulated link
+  NetemFdAdapter( AdapterT&& adapter, const LinkConfig& uplink )
+    : _adapter( std::move( adapter ) ), _uplink( uplink )
+  {}
+
+  //! Read from the underlying AdapterT instance
+  std::optional<TCPMessage> read() { return _adapter.read(); }
+
+  //! \brief Send a segment over the emulated link (the segment is copied, as it may only be borrowed)
+  //! \param[in] seg is the segment to send
+  void write( const TCPMessage& seg )
+  {
+    const size_t bytes = IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH + seg.sender->payload.size();
+    _uplink.send( clone( seg ), bytes );
+    _deliver(); // (in case the link has no delay)
+  }
+
+  //! Advance the emulated link's clock, and write out the segments that arrived meanwhile
+  void tick( const size_t ms_since_last_tick )
+  {
+    _uplink.tick( ms_since_last_tick );
+    _deliver();
+    _adapter.tick( ms_since_last_tick );
+  }
+
+  //! \brief Run the emulated link until every segment in flight has been written out (or dropped)
+  //! \details For when the socket stops ticking (e.g. once the connection is over), so that the segments it
+  //! sent last (such as the final ACK or FIN) still reach the other end. They leave as soon as the link would
+  //! deliver them, without waiting for the link's delay in real time.
+  void flush()
+  {
+    while ( const auto arrival = _uplink.next_arrival_ms() ) {
+      const size_t ms = arrival.value() > _uplink.now_ms() ? arrival.value() - _uplink.now_ms() : 0;
+      tick( ms );
+    }
+  }
+
+  //! The emulated link (e.g. for its statistics)
+  const LinkEmulator<TCPMessage>& uplink() const { return _uplink; }
+
+  //! \name
+  //! Passthrough functions to the underlying AdapterT instance
+
+  void set_listening( const bool l ) { _adapter.set_listening( l ); } //!< FdAdapterBase::set_listening passthrough
+  const FdAdapterConfig& config() const { return _adapter.config(); } //!< FdAdapterBase::config passthrough
+  FdAdapterConfig& config_mut() { return _adapter.config_mut(); }     //!< FdAdapterBase::config_mut passthrough
+};
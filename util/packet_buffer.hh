@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+//! \brief One packet in one contiguous buffer, with room reserved in front for headers (like a Linux sk_buff)
+//! \details The packet's bytes are the range [head, tail) of a single string. Going down the stack, each layer
+//! writes its header into the headroom with push() (instead of building a list of separately allocated
+//! buffers), so the finished packet can go to a device with one write() of data(). put() and append() add bytes
+//! at the tail, and pull() removes a header from the front on the way up.
+class PacketBuffer
+{
+public:
+  //! Default headroom: enough for a virtio-net, Ethernet, IPv4 and TCP header (with options)
+  static constexpr size_t DEFAULT_HEADROOM = 128;
+
+  //! An empty packet with room for `capacity` bytes, after `headroom` bytes for headers
+  explicit PacketBuffer( size_t capacity = 0, size_t headroom = DEFAULT_HEADROOM )
+    : storage_( headroom + capacity, 0 ), head_( headroom ), tail_( headroom )
+  {}
+
+  //! Extend the packet by `length` bytes at the front (taken from the headroom) and return them, for a header
+  std::span<char> push( size_t length )
+  {
+    if ( length > head_ ) {
+      throw std::runtime_error( "PacketBuffer: not enough headroom" );
+    }
+    head_ -= length;
+    return { storage_.data() + head_, length };
+  }
+
+  //! Extend the packet by `length` bytes at the back and return them (growing the buffer if necessary)
+  std::span<char> put( size_t length )
+  {
+    if ( length > tailroom() ) {
+      storage_.resize( tail_ + length );
+    }
+    tail_ += length;
+    return { storage_.data() + tail_ - length, length };
+  }
+
+  //! Copy bytes to the back of the packet
+  void append( std::string_view bytes ) { std::memcpy( put( bytes.size() ).data(), bytes.data(), bytes.size() ); }
+
+  //! Remove `length` bytes (e.g. a parsed header) from the front of the packet; they become headroom
+  void pull( size_t length )
+  {
+    if ( length > size() ) {
+      throw std::runtime_error( "PacketBuffer: pulled more than the packet" );
+    }
+    head_ += length;
+  }
+
+  //! Shorten the packet to its first `length` bytes
+  void trim( size_t length )
+  {
+    if ( length < size() ) {
+      tail_ = head_ + length;
+    }
+  }
+
+  //! The packet's bytes
+  std::string_view data() const { return { storage_.data() + head_, size() }; }
+  std::span<char> mutable_data() { return { storage_.data() + head_, size() }; }
+
+  // Accessors
+  size_t size() const { return tail_ - head_; }
+  bool empty() const { return size() == 0; }
+  size_t headroom() const { return head_; }
+  size_t tailroom() const { return storage_.size() - tail_; }
+
+private:
+  std::string storage_;
+  size_t head_;
+  size_t tail_;
+};
@@ -1,27 +1,28 @@
 #include "parser.hh"
 
 #include <cassert>
+#include <cstring>
 #include <string>
 
 using namespace std;
 
 string_view Parser::BufferList::peek() const
 {
-  if ( buffer_.empty() ) {
+  if ( first_ == buffer_.size() ) {
     throw runtime_error( "peek on empty BufferList" );
   }
-  return string_view { buffer_.front().get() }.substr( skip_ );
+  return string_view { buffer_[first_].get() }.substr( skip_ );
 }
 
 void Parser::BufferList::remove_prefix( uint64_t len )
 {
-  while ( len and not buffer_.empty() ) {
+  while ( len and first_ < buffer_.size() ) {
     const uint64_t to_pop_now = min( len, peek().size() );
     skip_ += to_pop_now;
     len -= to_pop_now;
     size_ -= to_pop_now;
-    if ( skip_ == buffer_.front()->size() ) {
-      buffer_.pop_front();
+    if ( skip_ == buffer_[first_].get().size() ) {
+      ++first_;
       skip_ = 0;
     }
   }
@@ -35,34 +36,38 @@ void Parser::BufferList::truncate( size_t len )
 
   if ( len == 0 ) {
     buffer_.clear();
+    first_ = 0;
+    skip_ = 0;
     size_ = 0;
     return;
   }
 
   size_t size_so_far = 0;
-  auto it = buffer_.begin();
+  uint64_t skip = skip_; // the first buffer begins `skip_` bytes in
+  auto it = buffer_.begin() + static_cast<ptrdiff_t>( first_ );
   while ( it != buffer_.end() ) {
-    if ( size_so_far + it->get().size() < len ) {
-      size_so_far += it->get().size();
+    const size_t remaining_size = it->get().size() - skip;
+    if ( size_so_far + remaining_size < len ) {
+      size_so_far += remaining_size;
+      skip = 0;
       ++it;
       continue;
     }
 
-    if ( size_so_far + it->get().size() == len ) {
+    if ( size_so_far + remaining_size == len ) {
       ++it;
       break;
     }
 
-    assert( !it->get().empty() );
+    assert( remaining_size > 0 );
     assert( len > size_so_far );
-    assert( len - size_so_far < it->get().size() );
-    it->get_mut().resize( len - size_so_far );
+    assert( len - size_so_far < remaining_size );
+    it->get_mut().resize( skip + len - size_so_far );
+    ++it;
     break;
   }
 
-  while ( it != buffer_.end() ) {
-    it = buffer_.erase( it );
-  }
+  buffer_.erase( it, buffer_.end() );
 
   size_ = len;
 }
@@ -74,14 +79,15 @@ void Parser::BufferList::dump_all( vector<Ref<std::string>>& out )
     return;
   }
   if ( skip_ ) {
-    out.emplace_back( buffer_.front()->substr( skip_ ) );
-  } else {
-    out.push_back( move( buffer_.front() ) );
+    // drop the consumed prefix in place (instead of copying the rest into a new string)
+    buffer_[first_]->erase( 0, skip_ );
+    skip_ = 0;
   }
-  buffer_.pop_front();
-  for ( auto&& x : buffer_ ) {
-    out.emplace_back( move( x ) );
+  for ( auto it = buffer_.begin() + static_cast<ptrdiff_t>( first_ ); it != buffer_.end(); ++it ) {
+    out.emplace_back( move( *it ) );
   }
+  first_ = buffer_.size();
+  size_ = 0;
 }
 
 vector<string_view> Parser::BufferList::buffer() const
@@ -92,13 +98,54 @@ vector<string_view> Parser::BufferList::buffer() const
   vector<string_view> ret;
   ret.reserve( buffer_segment_count() );
   auto tmp_skip = skip_;
-  for ( const auto& x : buffer_ ) {
-    ret.push_back( string_view { x.get() }.substr( tmp_skip ) );
+  for ( auto it = buffer_.begin() + static_cast<ptrdiff_t>( first_ ); it != buffer_.end(); ++it ) {
+    ret.push_back( string_view { it->get() }.substr( tmp_skip ) );
     tmp_skip = 0;
   }
   return ret;
 }
 
+void Parser::remove_prefix( size_t n )
+{
+  if ( use_view_ ) {
+    view_.remove_prefix( min( n, view_.size() ) );
+    return;
+  }
+  input_.remove_prefix( n );
+}
+
+void Parser::truncate( size_t len )
+{
+  if ( use_view_ ) {
+    view_ = view_.substr( 0, len );
+    return;
+  }
+  input_.truncate( len );
+}
+
+void Parser::all_remaining( vector<Ref<std::string>>& out )
+{
+  if ( not use_view_ ) {
+    input_.dump_all( out );
+    return;
+  }
+
+  // the caller's buffer isn't ours to hand over, so what is left of it is copied (once)
+  out.clear();
+  if ( not view_.empty() ) {
+    out.emplace_back( std::string { view_ } );
+    view_ = {};
+  }
+}
+
+vector<string_view> Parser::buffer() const
+{
+  if ( use_view_ ) {
+    return view_.empty() ? vector<string_view> {} : vector<string_view> { view_ };
+  }
+  return input_.buffer();
+}
+
 void Parser::string( span<char> out )
 {
   check_size( out.size() );
@@ -106,6 +153,12 @@ void Parser::string( span<char> out )
     return;
   }
 
+  if ( use_view_ ) {
+    memcpy( out.data(), view_.data(), out.size() );
+    view_.remove_prefix( out.size() );
+    return;
+  }
+
   auto next = out.begin();
   while ( next != out.end() ) {
     const auto view = input_.peek().substr( 0, out.end() - next );
@@ -140,7 +193,9 @@ void Serializer::flush()
 
 void Serializer::buffer( string buf )
 {
-  if ( not buf.empty() ) {
+  if ( use_arena_ ) {
+    append( buf );
+  } else if ( not buf.empty() ) {
     flush();
     output_.emplace_back( move( buf ) );
   }
@@ -148,7 +203,9 @@ void Serializer::buffer( string buf )
 
 void Serializer::buffer( Ref<string> buf )
 {
-  if ( not buf.get().empty() ) {
+  if ( use_arena_ ) {
+    append( buf.get() );
+  } else if ( not buf.get().empty() ) {
     flush();
     output_.emplace_back( move( buf ) );
   }
@@ -163,6 +220,11 @@ void Serializer::buffer( const vector<Ref<string>>& bufs )
 
 vector<Ref<string>> Serializer::finish()
 {
+  if ( use_arena_ ) {
+    vector<Ref<string>> ret;
+    ret.emplace_back( string { arena_contents().begin(), arena_contents().end() } );
+    return ret;
+  }
   flush();
   return move( output_ );
 }
@@ -2,9 +2,10 @@
 
 #include "ref.hh"
 
+#include <bit>
 #include <concepts>
 #include <cstdint>
-#include <deque>
+#include <cstring>
 #include <ranges>
 #include <span>
 #include <stdexcept>
@@ -12,18 +13,46 @@
 #include <string_view>
 #include <vector>
 
+// Convert an integer between big-endian ("network") byte order and host byte order
+template<std::unsigned_integral T>
+constexpr T from_big_endian( const T val )
+{
+  if constexpr ( std::endian::native == std::endian::big or sizeof( T ) == 1 ) {
+    return val;
+  } else if constexpr ( sizeof( T ) == 2 ) {
+    return __builtin_bswap16( val );
+  } else if constexpr ( sizeof( T ) == 4 ) {
+    return __builtin_bswap32( val );
+  } else {
+    static_assert( sizeof( T ) == 8 );
+    return __builtin_bswap64( val );
+  }
+}
+
+template<std::unsigned_integral T>
+constexpr T to_big_endian( const T val )
+{
+  return from_big_endian( val );
+}
+
 class Parser
 {
   class BufferList
   {
     uint64_t size_ {};
-    std::deque<Ref<std::string>> buffer_ {};
+    std::vector<Ref<std::string>> buffer_ {}; // (a vector, so that a single buffer costs only one allocation)
+    size_t first_ {};                         // index of the first buffer that hasn't been consumed
     uint64_t skip_ {};
 
   public:
+    BufferList() = default;
+
     explicit BufferList( std::ranges::range auto&& buffers )
       requires std::is_convertible_v<decltype( std::move( *buffers.begin() ) ), Ref<std::string>>
     {
+      if constexpr ( std::ranges::sized_range<decltype( buffers )> ) {
+        buffer_.reserve( std::ranges::size( buffers ) );
+      }
       for ( auto&& x : buffers ) {
         buffer_.emplace_back( std::move( x ) );
         if ( buffer_.back().is_borrowed() ) {
@@ -36,21 +65,46 @@ class Parser
     uint64_t size() const { return size_; }
     uint64_t serialized_length() const { return size(); }
     bool empty() const { return size_ == 0; }
-    size_t buffer_segment_count() const { return buffer_.size(); }
+    size_t buffer_segment_count() const { return buffer_.size() - first_; }
+    bool whole_buffer_remaining() const { return buffer_segment_count() == 1 and skip_ == 0; }
 
     std::string_view peek() const;
     void remove_prefix( uint64_t len );
+
+    // Copy the next `len` bytes to `out` and remove them, if the first buffer has at least `len` bytes left.
+    // Returns false (and does nothing) otherwise.
+    bool take_contiguous( char* out, uint64_t len )
+    {
+      if ( first_ == buffer_.size() or buffer_[first_].get().size() - skip_ < len ) {
+        return false;
+      }
+      std::memcpy( out, buffer_[first_].get().data() + skip_, len );
+      skip_ += len;
+      size_ -= len;
+      if ( skip_ == buffer_[first_].get().size() ) {
+        ++first_;
+        skip_ = 0;
+      }
+      return true;
+    }
     void truncate( size_t len );
     void dump_all( std::vector<Ref<std::string>>& out );
     std::vector<std::string_view> buffer() const;
   };
 
-  BufferList input_;
+  BufferList input_ {};
+
+  // optional caller-provided contiguous buffer that is parsed instead (without taking ownership of it)
+  std::string_view view_ {};
+  bool use_view_ {};
+
   bool error_ {};
 
+  uint64_t remaining() const { return use_view_ ? view_.size() : input_.size(); }
+
   void check_size( const size_t size )
   {
-    if ( size > input_.size() ) {
+    if ( size > remaining() ) {
       error_ = true;
     }
   }
@@ -58,13 +112,21 @@ class Parser
 public:
   explicit Parser( std::ranges::range auto&& input ) : input_( std::forward<decltype( input )>( input ) ) {}
 
+  // Parse the bytes of `contiguous` in place (e.g. a packet in a caller-owned receive buffer, which must outlive
+  // the Parser). Each integer is then one unaligned big-endian load. all_remaining() copies what is left.
+  explicit Parser( std::string_view contiguous ) : view_( contiguous ), use_view_( true ) {}
+
   bool has_error() const { return error_; }
   void set_error() { error_ = true; }
-  void remove_prefix( size_t n ) { input_.remove_prefix( n ); }
-  void truncate( size_t len ) { input_.truncate( len ); }
+  void remove_prefix( size_t n );
+  void truncate( size_t len );
 
-  void all_remaining( std::vector<Ref<std::string>>& out ) { input_.dump_all( out ); }
-  std::vector<std::string_view> buffer() const { return input_.buffer(); }
+  void all_remaining( std::vector<Ref<std::string>>& out );
+  std::vector<std::string_view> buffer() const;
+
+  // Is what is left exactly one whole owned buffer (which all_remaining() hands over without copying or erasing
+  // anything)?
+  bool whole_buffer_remaining() const { return not use_view_ and input_.whole_buffer_remaining(); }
 
   void string( std::span<char> out );
   void concatenate_all_remaining( std::string& out );
@@ -77,6 +139,18 @@ public:
       return;
     }
 
+    // fast path: one (unaligned) big-endian load from a contiguous buffer
+    if ( use_view_ ) {
+      std::memcpy( &out, view_.data(), sizeof( T ) );
+      view_.remove_prefix( sizeof( T ) );
+      out = from_big_endian( out );
+      return;
+    }
+    if ( input_.take_contiguous( reinterpret_cast<char*>( &out ), sizeof( T ) ) ) {
+      out = from_big_endian( out );
+      return;
+    }
+
     if constexpr ( sizeof( T ) == 1 ) {
       out = static_cast<uint8_t>( input_.peek().front() );
       input_.remove_prefix( 1 );
@@ -97,22 +171,46 @@ class Serializer
   std::vector<Ref<std::string>> output_ {};
   std::string buffer_ {};
 
+  // optional caller-provided buffer that everything is written into instead
+  std::span<char> arena_ {};
+  size_t arena_used_ {};
+  bool use_arena_ {};
+
   void flush();
 
+  void append( std::string_view bytes )
+  {
+    if ( not use_arena_ ) {
+      buffer_.append( bytes );
+      return;
+    }
+
+    if ( bytes.size() > arena_.size() - arena_used_ ) {
+      throw std::runtime_error( "Serializer arena overflow" );
+    }
+    std::memcpy( arena_.data() + arena_used_, bytes.data(), bytes.size() );
+    arena_used_ += bytes.size();
+  }
+
 public:
+  Serializer() = default;
+
+  // Serialize into `arena` (one contiguous packet) instead of a list of strings; throws if it overflows
+  explicit Serializer( std::span<char> arena ) : arena_( arena ), use_arena_( true ) {}
+
   template<std::unsigned_integral T>
   void integer( const T val )
   {
-    constexpr uint64_t len = sizeof( T );
-
-    for ( uint64_t i = 0; i < len; ++i ) {
-      const uint8_t byte_val = val >> ( ( len - i - 1 ) * 8 );
-      buffer_.push_back( byte_val );
-    }
+    // one (unaligned) big-endian store
+    const T big_endian_val = to_big_endian( val );
+    append( { reinterpret_cast<const char*>( &big_endian_val ), sizeof( T ) } );
   }
 
   void buffer( std::string buf );
   void buffer( Ref<std::string> buf );
   void buffer( const std::vector<Ref<std::string>>& bufs );
   std::vector<Ref<std::string>> finish();
+
+  // The part of the arena written so far (empty without an arena)
+  std::span<char> arena_contents() const { return arena_.first( arena_used_ ); }
 };
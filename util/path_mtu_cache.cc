@@ -0,0 +1,25 @@
+#include "path_mtu_cache.hh"
+
+using namespace std;
+
+PathMTUCache& PathMTUCache::global()
+{
+  static PathMTUCache cache;
+  return cache;
+}
+
+optional<size_t> PathMTUCache::lookup( const uint32_t destination, const uint64_t now_ms ) const
+{
+  const lock_guard lock { mutex_ };
+  const auto it = entries_.find( destination );
+  if ( it == entries_.end() or now_ms >= it->second.stored_at + lifetime_ms_ ) {
+    return {};
+  }
+  return it->second.mtu;
+}
+
+void PathMTUCache::store( const uint32_t destination, const size_t mtu, const uint64_t now_ms )
+{
+  const lock_guard lock { mutex_ };
+  entries_.insert_or_assign( destination, Entry { mtu, now_ms } );
+}
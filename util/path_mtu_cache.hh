@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+//! \brief The path MTUs discovered for recent destinations (shared by all connections in the process)
+//! \details A connection that uses PLPMTUD (see TCPConfig::plpmtud) stores the MTU it found when it ends, and the
+//! next connection to the same destination starts from it instead of searching again. Entries age out after
+//! `lifetime_ms`, as paths change.
+class PathMTUCache
+{
+public:
+  static constexpr uint64_t DEFAULT_LIFETIME_MS = 10 * 60 * 1000; //!< (RFC 1191 section 6.3)
+
+  explicit PathMTUCache( uint64_t lifetime_ms = DEFAULT_LIFETIME_MS ) : lifetime_ms_( lifetime_ms ) {}
+
+  //! The cache shared by all connections
+  static PathMTUCache& global();
+
+  //! The MTU found for `destination` (an IPv4 address, as a number), unless none was stored in time
+  std::optional<size_t> lookup( uint32_t destination, uint64_t now_ms ) const;
+
+  //! Remember the MTU found for `destination`
+  void store( uint32_t destination, size_t mtu, uint64_t now_ms );
+
+private:
+  struct Entry
+  {
+    size_t mtu;
+    uint64_t stored_at;
+  };
+
+  uint64_t lifetime_ms_;
+  mutable std::mutex mutex_ {};
+  std::unordered_map<uint32_t, Entry> entries_ {};
+};
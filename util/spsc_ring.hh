@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//! \brief A FIFO queue in a ring of reusable slots, for one producer and one consumer (optionally on two threads)
+//! \details Elements are moved into and out of the slots in place, so once the ring is big enough, neither push()
+//! nor pop() allocates. The producer only ever writes the tail index and the consumer only the head, each
+//! publishing its progress with a single release store (and each keeping a cached copy of the other's index, so
+//! that they rarely touch the other's cache line).
+//!
+//! By default the ring grows when it is full, which is only safe while one thread uses it. After
+//! set_fixed_capacity(), it never grows: a push() to a full ring drops the element (and counts it), and a producer
+//! thread and a consumer thread may use the ring at the same time without locks.
+//!
+//! The usual queue interface: push() at the back, and empty(), front() and pop() at the front. (The consumer may
+//! move the element out of front() before popping it.)
+template<class T>
+class SPSCRing
+{
+public:
+  static constexpr size_t DEFAULT_CAPACITY = 64; //!< Initial number of slots
+
+  explicit SPSCRing( size_t capacity = DEFAULT_CAPACITY ) : slots_( round_up( capacity ) ) {}
+
+  //! \name
+  //! Move-only (moving is not thread-safe: neither ring may be in use)
+
+  //!@{
+  SPSCRing( const SPSCRing& ) = delete;
+  SPSCRing& operator=( const SPSCRing& ) = delete;
+
+  SPSCRing( SPSCRing&& other ) noexcept
+    : head_( other.head_.load() )
+    , tail_cache_( other.tail_cache_ )
+    , tail_( other.tail_.load() )
+    , head_cache_( other.head_cache_ )
+    , slots_( std::move( other.slots_ ) )
+    , fixed_( other.fixed_ )
+    , drops_( other.drops_.load() )
+  {
+    other.clear_indices();
+  }
+
+  SPSCRing& operator=( SPSCRing&& other ) noexcept
+  {
+    if ( this != &other ) {
+      head_ = other.head_.load();
+      head_cache_ = other.head_cache_;
+      tail_ = other.tail_.load();
+      tail_cache_ = other.tail_cache_;
+      slots_ = std::move( other.slots_ );
+      fixed_ = other.fixed_;
+      drops_ = other.drops_.load();
+      other.clear_indices();
+    }
+    return *this;
+  }
+
+  ~SPSCRing() = default;
+  //!@}
+
+  //! Stop growing: from now on the ring holds at most `capacity` elements (rounded up to a power of two), and
+  //! may be shared by a producer thread and a consumer thread. (Call before the threads start.)
+  void set_fixed_capacity( size_t capacity )
+  {
+    resize( round_up( capacity < size() ? size() : capacity ) );
+    fixed_ = true;
+  }
+
+  //! \name Producer
+
+  //!@{
+  //! Add an element at the back. Returns false (and drops the element) if the ring is full and can't grow.
+  bool push( T value )
+  {
+    const size_t tail = tail_.load( std::memory_order_relaxed );
+    if ( tail - head_cache_ == slots_.size() ) {
+      head_cache_ = head_.load( std::memory_order_acquire );
+      if ( tail - head_cache_ == slots_.size() ) {
+        if ( fixed_ ) {
+          drops_.fetch_add( 1, std::memory_order_relaxed );
+          return false;
+        }
+        resize( slots_.size() * 2 );
+        return push( std::move( value ) );
+      }
+    }
+
+    slots_[tail & ( slots_.size() - 1 )] = std::move( value );
+    tail_.store( tail + 1, std::memory_order_release );
+    return true;
+  }
+  //!@}
+
+  //! \name Consumer
+
+  //!@{
+  bool empty()
+  {
+    const size_t head = head_.load( std::memory_order_relaxed );
+    if ( head == tail_cache_ ) {
+      tail_cache_ = tail_.load( std::memory_order_acquire );
+    }
+    return head == tail_cache_;
+  }
+
+  //! The oldest element (the ring must not be empty)
+  T& front() { return slots_[head_.load( std::memory_order_relaxed ) & ( slots_.size() - 1 )]; }
+
+  //! Remove the oldest element (the ring must not be empty)
+  void pop()
+  {
+    const size_t head = head_.load( std::memory_order_relaxed );
+    slots_[head & ( slots_.size() - 1 )] = T {}; // (release whatever the element still owns)
+    head_.store( head + 1, std::memory_order_release );
+  }
+  //!@}
+
+  // Accessors
+  size_t size() const { return tail_.load( std::memory_order_acquire ) - head_.load( std::memory_order_acquire ); }
+  size_t capacity() const { return slots_.size(); }
+  bool fixed() const { return fixed_; }
+  uint64_t drops() const { return drops_.load( std::memory_order_relaxed ); } //!< Elements refused when full
+
+private:
+  static size_t round_up( size_t capacity )
+  {
+    size_t ret = 1;
+    while ( ret < capacity ) {
+      ret <<= 1;
+    }
+    return ret;
+  }
+
+  // Move the elements to `new_size` slots (single-threaded only)
+  void resize( size_t new_size )
+  {
+    const size_t head = head_.load();
+    const size_t count = size();
+    std::vector<T> slots( new_size );
+    for ( size_t i = 0; i < count; ++i ) {
+      slots[i] = std::move( slots_[( head + i ) & ( slots_.size() - 1 )] );
+    }
+    slots_ = std::move( slots );
+    head_ = 0;
+    head_cache_ = 0;
+    tail_ = count;
+    tail_cache_ = count;
+  }
+
+  void clear_indices()
+  {
+    head_ = 0;
+    head_cache_ = 0;
+    tail_ = 0;
+    tail_cache_ = 0;
+    slots_.clear();
+    slots_.resize( 1 );
+  }
+
+  // Written by the consumer (with the producer's last-seen tail)
+  alignas( 64 ) std::atomic<size_t> head_ { 0 };
+  size_t tail_cache_ { 0 };
+
+  // Written by the producer (with the consumer's last-seen head)
+  alignas( 64 ) std::atomic<size_t> tail_ { 0 };
+  size_t head_cache_ { 0 };
+
+  alignas( 64 ) std::vector<T> slots_;
+  bool fixed_ { false };
+  std::atomic<uint64_t> drops_ { 0 };
+};
@@ -10,15 +10,24 @@
 class TCPConfig
 {
 public:
-  static constexpr size_t DEFAULT_CAPACITY = 64000; //!< Default capacity
-  static constexpr size_t MAX_PAYLOAD_SIZE = 1000;  //!< Conservative max payload size for real Internet
-  static constexpr uint16_t TIMEOUT_DFLT = 1000;    //!< Default re-transmit timeout is 1 second
-  static constexpr unsigned MAX_RETX_ATTEMPTS = 8;  //!< Maximum re-transmit attempts before giving up
-
-  uint16_t rt_timeout = TIMEOUT_DFLT;      //!< Initial value of the retransmission timeout, in milliseconds
-  size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
-  size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
-  Wrap32 isn { 137 };                      //!< Default initial sequence number
+  static constexpr size_t DEFAULT_CAPACITY = 64000;        //!< Default capacity
+  static constexpr size_t MAX_PAYLOAD_SIZE = 1000;         //!< Conservative max payload size for real Internet
+  static constexpr uint16_t TIMEOUT_DFLT = 1000;           //!< Default re-transmit timeout is 1 second
+  static constexpr unsigned MAX_RETX_ATTEMPTS = 8;         //!< Maximum re-transmit attempts before giving up
+  static constexpr size_t PLPMTUD_MAX_PAYLOAD_SIZE = 1460; //!< Largest probe by default (fills a 1500-byte MTU)
+
+  uint16_t rt_timeout = TIMEOUT_DFLT;         //!< Initial value of the retransmission timeout, in milliseconds
+  size_t recv_capacity = DEFAULT_CAPACITY;    //!< Receive capacity, in bytes
+  size_t send_capacity = DEFAULT_CAPACITY;    //!< Sender capacity, in bytes
+  size_t max_payload_size = MAX_PAYLOAD_SIZE; //!< Largest payload in one outbound segment (larger with GSO)
+  Wrap32 isn { 137 };                         //!< Default initial sequence number
+
+  //! \name Packetization-layer path MTU discovery (RFC 4821): probe for segments larger than max_payload_size
+  //!@{
+  bool plpmtud = false;                                       //!< Off by default
+  size_t plpmtud_max_payload_size = PLPMTUD_MAX_PAYLOAD_SIZE; //!< Largest payload to probe for
+  size_t plpmtud_initial_payload_size = 0;                    //!< Payload known to fit the path (e.g. cached)
+  //!@}
 };
 
 //! Config for classes derived from FdAdapter
@@ -30,4 +39,8 @@ public:
 
   uint16_t loss_rate_dn = 0; //!< Downlink loss rate (for LossyFdAdapter)
   uint16_t loss_rate_up = 0; //!< Uplink loss rate (for LossyFdAdapter)
+
+  //! Largest TCP payload per segment on the wire: a longer one is a GSO super-packet, which the TUN device cuts
+  //! into segments of this size (for TCPOverIPv4OverTunFdAdapter with a virtio-net header)
+  size_t segment_size = TCPConfig::MAX_PAYLOAD_SIZE;
 };
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "ipv4_datagram.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+//! \brief A listening TCP endpoint that can serve many connections at once
+//! \details The TCPListener demultiplexes incoming IPv4 datagrams by their (remote address, remote port,
+//! local address) and hands each one to the TCPPeer for that connection. A SYN for an unknown connection
+//! creates a new TCPPeer in the SYN queue; once the three-way handshake completes, the connection moves to
+//! the accept queue, where it waits for the application to call accept(). Like the rest of the TCP
+//! implementation, the listener does no I/O itself: datagrams are passed in with receive() and passed out
+//! through the `transmit` function.
+class TCPListener
+{
+public:
+  static constexpr size_t DEFAULT_BACKLOG = 128; //!< Default limit on the length of the accept queue
+
+  //! A connection created by the listener
+  class Connection
+  {
+  public:
+    Connection( const TCPConfig& cfg,
+                uint32_t local_ip,
+                uint16_t local_port,
+                uint32_t remote_ip,
+                uint16_t remote_port )
+      : peer_( cfg )
+      , local_ip_( local_ip )
+      , local_port_( local_port )
+      , remote_ip_( remote_ip )
+      , remote_port_( remote_port )
+    {}
+
+    TCPPeer& peer() { return peer_; }
+    const TCPPeer& peer() const { return peer_; }
+
+    uint32_t local_ip() const { return local_ip_; }
+    uint16_t local_port() const { return local_port_; }
+    uint32_t remote_ip() const { return remote_ip_; }
+    uint16_t remote_port() const { return remote_port_; }
+
+    // Has the three-way handshake completed?
+    bool established() const { return peer_.has_ackno() and peer_.sender().sequence_numbers_in_flight() == 0; }
+
+  private:
+    friend class TCPListener;
+
+    enum class State : uint8_t
+    {
+      SynReceived, // in the SYN queue
+      Queued,      // in the accept queue
+      Accepted     // handed to the application
+    };
+
+    TCPPeer peer_;
+    uint32_t local_ip_;
+    uint16_t local_port_;
+    uint32_t remote_ip_;
+    uint16_t remote_port_;
+    State state_ { State::SynReceived };
+  };
+
+  //! Type of the `transmit` function that the listener uses to send datagrams
+  using TransmitFunction = std::function<void( const InternetDatagram& )>;
+
+  //! Listen on `local_port` at `local_ip` (0 accepts connections to any local address). At most `backlog`
+  //! connections may wait in each of the SYN queue and the accept queue; further SYNs are dropped.
+  TCPListener( const TCPConfig& cfg, uint32_t local_ip, uint16_t local_port, size_t backlog = DEFAULT_BACKLOG );
+
+  //! Process an incoming datagram, replying through `transmit` as needed
+  void receive( InternetDatagram dgram, const TransmitFunction& transmit );
+
+  //! Push outbound data on every connection (e.g. after the application has written to an outbound stream)
+  void push( const TransmitFunction& transmit );
+
+  //! Time has passed by the given # of milliseconds since the last time the tick() method was called
+  void tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit );
+
+  //! Take the oldest established connection from the accept queue (or nullptr if there is none)
+  std::shared_ptr<Connection> accept();
+
+  // Accessors
+  size_t backlog() const { return backlog_; }
+  size_t syn_queue_size() const { return syn_queue_size_; }
+  size_t accept_queue_size() const { return accept_queue_.size(); }
+  size_t connection_count() const { return connections_.size(); }
+  uint64_t syns_dropped() const { return syns_dropped_; } // SYNs refused because a queue was full
+
+private:
+  struct ConnectionKey
+  {
+    uint32_t remote_ip;
+    uint32_t local_ip;
+    uint16_t remote_port;
+
+    bool operator==( const ConnectionKey& other ) const = default;
+  };
+
+  struct ConnectionKeyHash
+  {
+    // (the two addresses fill 64 bits, and the port is mixed in with the boost::hash_combine recipe)
+    size_t operator()( const ConnectionKey& key ) const
+    {
+      size_t seed = std::hash<uint64_t> {}( ( static_cast<uint64_t>( key.remote_ip ) << 32 ) | key.local_ip );
+      seed ^= std::hash<uint16_t> {}( key.remote_port ) + 0x9e3779b97f4a7c15 + ( seed << 6 ) + ( seed >> 2 );
+      return seed;
+    }
+  };
+
+  void transmit_from( const Connection& conn, const TCPMessage& msg, const TransmitFunction& transmit ) const;
+
+  // Move a connection whose handshake has completed from the SYN queue to the accept queue, if there is room
+  void maybe_enqueue( const std::shared_ptr<Connection>& conn );
+
+  TCPConfig cfg_;
+  uint32_t local_ip_;
+  uint16_t local_port_;
+  size_t backlog_;
+
+  std::unordered_map<ConnectionKey, std::shared_ptr<Connection>, ConnectionKeyHash> connections_ {};
+  std::deque<std::shared_ptr<Connection>> accept_queue_ {};
+  size_t syn_queue_size_ {};
+  uint64_t syns_dropped_ {};
+};
@@ -9,6 +9,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <mutex>
 #include <optional>
 #include <thread>
 
@@ -56,6 +57,13 @@ public:
   // Return peer address from underlying datagram adapter
   const Address& peer_address() const { return _datagram_adapter.config().destination; }
 
+  //! The connection's statistics, as of the TCPPeer thread's last event (and kept after the connection ends)
+  TCPStats stats() const
+  {
+    const std::lock_guard lock { _stats_mutex };
+    return _stats;
+  }
+
 protected:
   //! Adapter to underlying datagram socket (e.g., UDP or IP)
   AdaptT _datagram_adapter;
@@ -92,10 +100,20 @@ private:
   bool _outbound_shutdown { false }; //!< Has the owner shut down the outbound data to the TCP connection?
 
   bool _fully_acked { false }; //!< Has the outbound data been fully acknowledged by the peer?
+
+  //! \name
+  //! The TCPPeer thread copies the TCPPeer's statistics here after every event, for the owner to read
+
+  //!@{
+  mutable std::mutex _stats_mutex {};
+  TCPStats _stats {};
+  void _publish_stats();
+  //!@}
 };
 
 using TCPOverIPv4MinnowSocket = TCPMinnowSocket<TCPOverIPv4OverTunFdAdapter>;
 using LossyTCPOverIPv4MinnowSocket = TCPMinnowSocket<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>;
+using NetemTCPOverIPv4MinnowSocket = TCPMinnowSocket<NetemFdAdapter<TCPOverIPv4OverTunFdAdapter>>;
 
 //! \class TCPMinnowSocket
 //! This class involves the simultaneous operation of two threads.
@@ -111,7 +129,8 @@ using LossyTCPOverIPv4MinnowSocket = TCPMinnowSocket<LossyFdAdapter<TCPOverIPv4O
 //!
 //! There are a few notable differences between the TCPMinnowSocket and TCPSocket interfaces:
 //!
-//! - a TCPMinnowSocket can only accept a single connection
+//! - a TCPMinnowSocket can only accept a single connection (a server that needs to accept many
+//!   connections at once can demultiplex them with a TCPListener)
 //! - listen_and_accept() is a blocking function call that acts as both [listen(2)](\ref man2::listen)
 //!   and [accept(2)](\ref man2::accept)
 //! - if TCPMinnowSocket is destructed while a TCP connection is open, the connection is
@@ -1,7 +1,11 @@
 #include "tcp_minnow_socket.hh"
 
 #include "exception.hh"
+#include "ipv4_header.hh"
+#include "path_mtu_cache.hh"
+#include "tcp_segment.hh"
 
+#include <algorithm>
 #include <cstddef>
 #include <exception>
 #include <iostream>
@@ -11,6 +15,7 @@
 #include <utility>
 
 static constexpr size_t TCP_TICK_MS = 10;
+static constexpr size_t MAX_DATAGRAMS_PER_EVENT = 64;
 
 inline uint64_t timestamp_ms()
 {
@@ -34,15 +39,25 @@ void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition
       throw std::runtime_error( "_tcp_loop entered before TCPPeer initialized" );
     }
 
+    // (the adapter keeps ticking after the peer is done, as it may still hold segments the peer sent)
+    const auto next_time = timestamp_ms();
     if ( _tcp.value().active() ) {
-      const auto next_time = timestamp_ms();
       _tcp.value().tick( next_time - base_time, [&]( auto x ) { _datagram_adapter.write( x ); } );
-      _datagram_adapter.tick( next_time - base_time );
-      base_time = next_time;
     }
+    _datagram_adapter.tick( next_time - base_time );
+    base_time = next_time;
+    _publish_stats();
   }
 }
 
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_publish_stats()
+{
+  const TCPStats stats = _tcp->stats();
+  const std::lock_guard lock { _stats_mutex };
+  _stats = stats;
+}
+
 //! \param[in] data_socket_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
 //! \param[in] datagram_interface is the interface for reading and writing datagrams
 template<TCPDatagramAdapter AdaptT>
@@ -61,6 +76,10 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
 {
   _tcp.emplace( config );
 
+  // The datagram fd is drained in batches (see rule 1), so reads must not block once it runs dry. (A write
+  // that would block then writes nothing, and the adapter waits for room and writes again.)
+  _datagram_adapter.fd().set_blocking( false );
+
   // Set up the event loop
 
   // There are three events to handle:
@@ -76,13 +95,23 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
   //    to the local stream socket back to the application)
 
   // rule 1: read from filtered packet stream and dump into TCPConnection
+  //
+  // Each readiness event drains up to MAX_DATAGRAMS_PER_EVENT datagrams, instead of going back to poll()
+  // (and through the rest of the event loop) for every one of them. The fd's read count tells whether a
+  // read() found a datagram (which may still have been filtered out) or found the fd empty.
   _eventloop.add_rule(
     "receive TCP segment from the network",
     _datagram_adapter.fd(),
     Direction::In,
     [&] {
-      if ( auto seg = _datagram_adapter.read() ) {
-        _tcp->receive( std::move( seg.value() ), [&]( auto x ) { _datagram_adapter.write( x ); } );
+      for ( size_t i = 0; i < MAX_DATAGRAMS_PER_EVENT and _tcp->active(); ++i ) {
+        const auto reads_before = _datagram_adapter.fd().read_count();
+        if ( auto seg = _datagram_adapter.read() ) {
+          _tcp->receive( std::move( seg.value() ), [&]( auto x ) { _datagram_adapter.write( x ); } );
+        }
+        if ( _datagram_adapter.fd().read_count() == reads_before ) {
+          break;
+        }
       }
 
       // debugging output:
@@ -221,9 +250,23 @@ void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterCo
     throw std::runtime_error( "connect() with TCPConnection already initialized" );
   }
 
-  _initialize_TCP( c_tcp );
+  TCPConfig config = c_tcp;
+  FdAdapterConfig adapter_config = c_ad;
+  const auto mtu = PathMTUCache::global().lookup( c_ad.destination.ipv4_numeric(), timestamp_ms() );
+  if ( config.plpmtud ) {
+    // start from the path MTU that an earlier connection to the destination found
+    if ( mtu ) {
+      config.plpmtud_initial_payload_size = *mtu - IPv4Header::LENGTH - TCPSegment::HEADER_LENGTH;
+    }
+    // (PLPMTUD sizes every segment itself, probes included, so none of them is to be cut up by GSO)
+    adapter_config.segment_size = std::max( adapter_config.segment_size, config.plpmtud_max_payload_size );
+  } else if ( mtu ) {
+    // GSO super-packets are cut into segments of the size that an earlier connection found for the path
+    adapter_config.segment_size = *mtu - IPv4Header::LENGTH - TCPSegment::HEADER_LENGTH;
+  }
+  _initialize_TCP( config );
 
-  _datagram_adapter.config_mut() = c_ad;
+  _datagram_adapter.config_mut() = adapter_config;
 
   std::cerr << "DEBUG: minnow connecting to " << c_ad.destination.to_string() << "...\n";
 
@@ -276,11 +319,22 @@ void TCPMinnowSocket<AdaptT>::_tcp_main()
       throw std::runtime_error( "no TCP" );
     }
     _tcp_loop( [] { return true; } );
+    // once the loop stops ticking, write out what the adapter still holds (e.g. the final ACK)
+    if constexpr ( requires { _datagram_adapter.flush(); } ) {
+      _datagram_adapter.flush();
+    }
     shutdown( SHUT_RDWR );
     if ( not _tcp.value().active() ) {
       std::cerr << "DEBUG: minnow TCP connection finished "
                 << ( _tcp->inbound_reader().has_error() ? "uncleanly.\n" : "cleanly.\n" );
     }
+    if ( _tcp->sender().plpmtud_enabled() ) {
+      PathMTUCache::global().store( peer_address().ipv4_numeric(),
+                                    _tcp->sender().max_payload_size() + IPv4Header::LENGTH
+                                      + TCPSegment::HEADER_LENGTH,
+                                    timestamp_ms() );
+    }
+    _publish_stats();
     _tcp.reset();
   } catch ( const std::exception& e ) {
     std::cerr << "Exception in TCPConnection runner thread: " << e.what() << "\n";
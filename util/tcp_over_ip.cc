@@ -1,10 +1,12 @@
 #include "tcp_over_ip.hh"
 
+#include "checksum.hh"
 #include "helpers.hh"
 #include "ipv4_datagram.hh"
 #include "ipv4_header.hh"
 
 #include <arpa/inet.h>
+#include <string>
 #include <unistd.h>
 #include <utility>
 
@@ -21,28 +23,41 @@ using namespace std;
 //! and the TCP segment read from the wire includes a SYN, this function clears the
 //! `_listen` flag and records the source and destination addresses and port numbers
 //! from the TCP header; it uses this information to filter future reads.
+//!
+//! `verify_checksum` may be false when the device reading the datagram has already checked (or will
+//! fill in) the TCP checksum.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
-optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_dgram )
+optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_dgram, bool verify_checksum )
+{
+  Parser payload { move( ip_dgram.payload ) };
+  return unwrap_tcp_in_ip( ip_dgram.header, payload, verify_checksum );
+}
+
+//! \details `payload` holds the bytes that follow the header (up to the datagram's length).
+optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const IPv4Header& ip_header,
+                                                           Parser& payload,
+                                                           bool verify_checksum )
 {
   // is the IPv4 datagram for us?
   // Note: it's valid to bind to address "0" (INADDR_ANY) and reply from actual address contacted
-  if ( not listening() and ( ip_dgram.header.dst != config().source.ipv4_numeric() ) ) {
+  if ( not listening() and ( ip_header.dst != config().source.ipv4_numeric() ) ) {
     return {};
   }
 
   // is the IPv4 datagram from our peer?
-  if ( not listening() and ( ip_dgram.header.src != config().destination.ipv4_numeric() ) ) {
+  if ( not listening() and ( ip_header.src != config().destination.ipv4_numeric() ) ) {
     return {};
   }
 
   // does the IPv4 datagram claim that its payload is a TCP segment?
-  if ( ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
+  if ( ip_header.proto != IPv4Header::PROTO_TCP ) {
     return {};
   }
 
   // is the payload a valid TCP segment?
   TCPSegment tcp_seg;
-  if ( not parse( tcp_seg, move( ip_dgram.payload ), ip_dgram.header.pseudo_checksum() ) ) {
+  tcp_seg.parse( payload, ip_header.pseudo_checksum(), verify_checksum );
+  if ( payload.has_error() ) {
     return {};
   }
 
@@ -54,9 +69,9 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_d
   // should we target this source addr/port (and use its destination addr as our source) in reply?
   if ( listening() ) {
     if ( tcp_seg.message.sender->SYN and not tcp_seg.message.sender->RST ) {
-      config_mutable().source = Address { inet_ntoa( { htobe32( ip_dgram.header.dst ) } ), config().source.port() };
+      config_mutable().source = Address { inet_ntoa( { htobe32( ip_header.dst ) } ), config().source.port() };
       config_mutable().destination
-        = Address { inet_ntoa( { htobe32( ip_dgram.header.src ) } ), tcp_seg.udinfo.src_port };
+        = Address { inet_ntoa( { htobe32( ip_header.src ) } ), tcp_seg.udinfo.src_port };
       set_listening( false );
     } else {
       return {};
@@ -74,23 +89,81 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_d
 //! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
 //! \param[in] seg is the TCP segment to convert
 InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
+{
+  const UserDatagramInfo ports {
+    .src_port = config().source.port(), .dst_port = config().destination.port(), .cksum = 0 };
+  return wrap_tcp_in_ip( msg, config().source.ipv4_numeric(), config().destination.ipv4_numeric(), ports );
+}
+
+//! \param[in] msg is the TCP message to convert
+//! \param[in] src_ip is the numeric source address of the datagram
+//! \param[in] dst_ip is the numeric destination address of the datagram
+//! \param[in] ports holds the source and destination port numbers (the checksum field is ignored)
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg,
+                                                     uint32_t src_ip,
+                                                     uint32_t dst_ip,
+                                                     UserDatagramInfo ports )
 {
   const size_t payload_size = msg.sender->payload.size();
-  TCPSegment seg { .message = { msg.sender.borrow(), msg.receiver.borrow() } };
-  // set the port numbers in the TCP segment
-  seg.udinfo.src_port = config().source.port();
-  seg.udinfo.dst_port = config().destination.port();
+  TCPSegment seg { .message = { msg.sender.borrow(), msg.receiver.borrow() }, .udinfo = ports };
 
   // create an Internet Datagram and set its addresses and length
   InternetDatagram ip_dgram;
-  ip_dgram.header.src = config().source.ipv4_numeric();
-  ip_dgram.header.dst = config().destination.ipv4_numeric();
+  ip_dgram.header.src = src_ip;
+  ip_dgram.header.dst = dst_ip;
   ip_dgram.header.len = ip_dgram.header.hlen * 4 + 20 /* tcp header len */ + payload_size;
 
-  // set payload, calculating TCP checksum using information from IP header
-  seg.compute_checksum( ip_dgram.header.pseudo_checksum() );
+  // The datagram may outlive msg, so it gets its own copy of the payload, and the TCP checksum (using
+  // information from the IP header) is computed in the same pass over the payload.
+  InternetChecksum check = seg.start_checksum( ip_dgram.header.pseudo_checksum() );
+  string payload;
+  payload.reserve( payload_size );
+  check.append_and_add( payload, msg.sender->payload );
+  seg.udinfo.cksum = check.value();
   ip_dgram.header.compute_checksum();
-  ip_dgram.payload = serialize( seg );
+
+  Serializer serializer;
+  seg.serialize_header( serializer );
+  serializer.buffer( move( payload ) );
+  ip_dgram.payload = serializer.finish();
 
   return ip_dgram;
 }
+
+PacketBuffer TCPOverIPv4Adapter::wrap_tcp_in_packet( const TCPMessage& msg, size_t headroom )
+{
+  const UserDatagramInfo ports {
+    .src_port = config().source.port(), .dst_port = config().destination.port(), .cksum = 0 };
+  return wrap_tcp_in_packet(
+    msg, config().source.ipv4_numeric(), config().destination.ipv4_numeric(), ports, headroom );
+}
+
+//! \details The payload is copied into the buffer once (and summed for the TCP checksum in the same pass), and
+//! then the TCP and IPv4 headers are written in front of it, in place.
+PacketBuffer TCPOverIPv4Adapter::wrap_tcp_in_packet( const TCPMessage& msg,
+                                                     uint32_t src_ip,
+                                                     uint32_t dst_ip,
+                                                     UserDatagramInfo ports,
+                                                     size_t headroom )
+{
+  const string& payload = msg.sender->payload;
+  TCPSegment seg { .message = { msg.sender.borrow(), msg.receiver.borrow() }, .udinfo = ports };
+
+  IPv4Header ip_header;
+  ip_header.src = src_ip;
+  ip_header.dst = dst_ip;
+  ip_header.len = IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH + payload.size();
+  ip_header.compute_checksum();
+
+  PacketBuffer packet { payload.size(), headroom + IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH };
+  InternetChecksum check = seg.start_checksum( ip_header.pseudo_checksum() );
+  check.copy_and_add( packet.put( payload.size() ), payload );
+  seg.udinfo.cksum = check.value();
+
+  Serializer tcp_serializer { packet.push( TCPSegment::HEADER_LENGTH ) };
+  seg.serialize_header( tcp_serializer );
+  Serializer ip_serializer { packet.push( IPv4Header::LENGTH ) };
+  ip_header.serialize( ip_serializer );
+
+  return packet;
+}
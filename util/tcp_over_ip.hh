@@ -2,6 +2,7 @@
 
 #include "fd_adapter.hh"
 #include "ipv4_datagram.hh"
+#include "packet_buffer.hh"
 #include "tcp_segment.hh"
 
 #include <optional>
@@ -10,7 +11,32 @@
 class TCPOverIPv4Adapter : public FdAdapterBase
 {
 public:
-  std::optional<TCPMessage> unwrap_tcp_in_ip( InternetDatagram ip_dgram );
+  std::optional<TCPMessage> unwrap_tcp_in_ip( InternetDatagram ip_dgram, bool verify_checksum = true );
+
+  //! Unwrap the TCP segment that follows an (already parsed) IPv4 header, e.g. in place in a receive buffer
+  std::optional<TCPMessage> unwrap_tcp_in_ip( const IPv4Header& ip_header,
+                                              Parser& payload,
+                                              bool verify_checksum = true );
 
   InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg );
+
+  //! Wrap a TCP message between explicit (numeric) addresses, without consulting an adapter config
+  static InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg,
+                                          uint32_t src_ip,
+                                          uint32_t dst_ip,
+                                          UserDatagramInfo ports );
+
+  //! \name
+  //! Wrap a TCP message in an IPv4 datagram serialized into one contiguous PacketBuffer, leaving `headroom`
+  //! bytes in front of it for lower-layer headers
+
+  //!@{
+  PacketBuffer wrap_tcp_in_packet( const TCPMessage& msg, size_t headroom = PacketBuffer::DEFAULT_HEADROOM );
+
+  static PacketBuffer wrap_tcp_in_packet( const TCPMessage& msg,
+                                          uint32_t src_ip,
+                                          uint32_t dst_ip,
+                                          UserDatagramInfo ports,
+                                          size_t headroom = PacketBuffer::DEFAULT_HEADROOM );
+  //!@}
 };
@@ -7,9 +7,30 @@
 #include "tcp_sender.hh"
 #include "tcp_sender_message.hh"
 
+#include <cstdint>
 #include <functional>
 #include <optional>
 
+/* A snapshot of one connection's counters and state, like Linux's struct tcp_info */
+struct TCPStats
+{
+  TCPSender::Stats sender {}; // bytes and segments sent, retransmitted and acknowledged; RTT; time limited by what
+
+  // Sender state
+  uint64_t bytes_in_flight {};  // sequence numbers sent but not yet acknowledged
+  uint64_t window_size {};      // the peer's advertised receive window
+  uint64_t rto_ms {};           // retransmission timeout (including backoff)
+  uint64_t max_payload_size {}; // largest payload in a segment
+
+  // Receiver state
+  uint64_t bytes_received {};            // bytes of the inbound stream reassembled so far
+  uint64_t reassembler_pending_bytes {}; // bytes received out of order, waiting for the gap before them
+  uint64_t receive_window {};            // the window advertised to the peer
+
+  uint64_t segments_received {}; // from the peer
+  uint64_t acks_sent {};         // empty segments sent to acknowledge the peer's
+};
+
 class TCPPeer
 {
   auto make_send( const auto& transmit )
@@ -18,7 +39,13 @@ class TCPPeer
   }
 
 public:
-  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg ) {}
+  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg )
+  {
+    sender_.set_max_payload_size( cfg_.max_payload_size );
+    if ( cfg_.plpmtud and cfg_.plpmtud_max_payload_size > cfg_.max_payload_size ) {
+      sender_.enable_plpmtud( cfg_.plpmtud_max_payload_size, cfg_.plpmtud_initial_payload_size );
+    }
+  }
 
   Writer& outbound_writer() { return sender_.writer(); }
   Reader& inbound_reader() { return receiver_.reader(); }
@@ -55,6 +82,7 @@ public:
 
     // Record time in case this peer has to linger after streams finish.
     time_of_last_receipt_ = cumulative_time_;
+    ++segments_received_;
 
     // If SenderMessage occupies a sequence number, make sure to reply.
     need_send_ |= ( msg.sender->sequence_length() > 0 );
@@ -65,15 +93,17 @@ public:
     need_send_ |= ( our_ackno.has_value() and msg.sender->seqno + 1 == our_ackno.value() );
 
     // Give incoming TCPSenderMessage to receiver.
-    receiver_.receive( std::move( msg.sender ) );
+    const bool carried_data = msg.sender->sequence_length() > 0;
+    receiver_.receive( msg.sender.release() );
 
-    // Give incoming TCPReceiverMessage to sender.
-    sender_.receive( msg.receiver );
+    // Give incoming TCPReceiverMessage to sender (an ACK that came with data isn't a duplicate ACK).
+    sender_.receive( msg.receiver, carried_data );
 
     // Send reply if needed.
     push( transmit );
     if ( need_send_ ) {
       send( sender_.make_empty_message(), transmit );
+      ++acks_sent_;
     }
 
     // Did the inbound stream finish before the outbound stream? If so, no need to linger after streams finish.
@@ -82,6 +112,21 @@ public:
     }
   }
 
+  /* Statistics: plain counters kept all the time, collected into a snapshot */
+  TCPStats stats() const
+  {
+    return { .sender = sender_.stats(),
+             .bytes_in_flight = sender_.sequence_numbers_in_flight(),
+             .window_size = sender_.window_size(),
+             .rto_ms = sender_.rto_ms(),
+             .max_payload_size = sender_.max_payload_size(),
+             .bytes_received = receiver_.writer().bytes_pushed(),
+             .reassembler_pending_bytes = receiver_.reassembler().count_bytes_pending(),
+             .receive_window = receiver_.send().window_size,
+             .segments_received = segments_received_,
+             .acks_sent = acks_sent_ };
+  }
+
   // Testing interface
   const TCPReceiver& receiver() const { return receiver_; }
   const TCPSender& sender() const { return sender_; }
@@ -102,4 +147,7 @@ private:
   bool linger_after_streams_finish_ { true }; // one peer may need to linger to make sure all closure conditions met
   uint64_t cumulative_time_ {};
   uint64_t time_of_last_receipt_ {};
+
+  uint64_t segments_received_ {};
+  uint64_t acks_sent_ {};
 };
@@ -3,21 +3,22 @@
 #include "helpers.hh"
 #include "wrapping_integers.hh"
 
+#include <array>
+#include <numeric>
 #include <sstream>
 
 using namespace std;
 
 static_assert( !( TCPSegment::HEADER_LENGTH & 0x03 ) ); // header length must be divisible by 4
 
-void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
+//! \details The checksum is verified in the same pass that gathers the payload: the header is summed where it
+//! sits, and then the payload is either moved into the message (if it is one whole owned buffer) and summed in
+//! place, or copied into the message and summed in one pass over each buffer. (A payload that follows the header
+//! in the same buffer is copied, rather than erasing the header from the front of that buffer.)
+void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum, bool verify_checksum )
 {
-  /* verify checksum */
-  InternetChecksum check { datagram_layer_pseudo_checksum };
-  check.add( parser.buffer() );
-  if ( check.value() ) {
-    parser.set_error();
-    return;
-  }
+  // views of the whole segment, to sum the header (including any options) once its length is known
+  const vector<string_view> segment = verify_checksum ? parser.buffer() : vector<string_view> {};
 
   uint32_t raw32 {};
   uint16_t raw16 {};
@@ -51,11 +52,47 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
   // skip any options or anything extra in the header
   if ( data_offset < ( HEADER_LENGTH >> 2 ) ) {
     parser.set_error();
+  }
+  if ( parser.has_error() ) {
     return;
   }
   parser.remove_prefix( data_offset * 4 - HEADER_LENGTH );
 
-  parser.concatenate_all_remaining( message.sender->payload );
+  InternetChecksum check { datagram_layer_pseudo_checksum };
+  size_t header_remaining = data_offset * 4;
+  for ( auto it = segment.begin(); it != segment.end() and header_remaining; ++it ) {
+    const auto header_part = it->substr( 0, header_remaining );
+    check.add( header_part );
+    header_remaining -= header_part.size();
+  }
+
+  string& out = message.sender->payload;
+  if ( parser.whole_buffer_remaining() ) {
+    vector<Ref<string>> payload;
+    parser.all_remaining( payload );
+    if ( verify_checksum ) {
+      check.add( string_view { payload.front().get() } );
+    }
+    out = payload.front().release();
+  } else {
+    const vector<string_view> payload = parser.buffer();
+    out.clear();
+    out.reserve( accumulate( payload.begin(), payload.end(), size_t {}, []( size_t total, string_view buf ) {
+      return total + buf.size();
+    } ) );
+    for ( const auto buf : payload ) {
+      if ( verify_checksum ) {
+        check.append_and_add( out, buf );
+      } else {
+        out.append( buf );
+      }
+    }
+    parser.remove_prefix( out.size() );
+  }
+
+  if ( verify_checksum and check.value() ) {
+    parser.set_error();
+  }
 }
 
 class Wrap32Serializable : public Wrap32
@@ -65,6 +102,12 @@ public:
 };
 
 void TCPSegment::serialize( Serializer& serializer ) const
+{
+  serialize_header( serializer );
+  serializer.buffer( Ref<string>::borrow( message.sender->payload ) ); // (not a copy: the output refers to it)
+}
+
+void TCPSegment::serialize_header( Serializer& serializer ) const
 {
   serializer.integer( udinfo.src_port );
   serializer.integer( udinfo.dst_port );
@@ -78,18 +121,26 @@ void TCPSegment::serialize( Serializer& serializer ) const
   serializer.integer( message.receiver->window_size );
   serializer.integer( udinfo.cksum );
   serializer.integer( uint16_t { 0 } ); // urgent pointer
-  serializer.buffer( message.sender->payload );
 }
 
 void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
 {
+  InternetChecksum check = start_checksum( datagram_layer_pseudo_checksum );
+  check.add( string_view { message.sender.get().payload } );
+  udinfo.cksum = check.value();
+}
+
+InternetChecksum TCPSegment::start_checksum( uint32_t datagram_layer_pseudo_checksum )
+{
+  // sum the header (serialized into a small stack buffer), rather than serializing a copy of the whole segment
   udinfo.cksum = 0;
-  Serializer s;
-  serialize( s );
+  array<char, HEADER_LENGTH> header {};
+  Serializer s { header };
+  serialize_header( s );
 
   InternetChecksum check { datagram_layer_pseudo_checksum };
-  check.add( s.finish() );
-  udinfo.cksum = check.value();
+  check.add( string_view { header.data(), header.size() } );
+  return check;
 }
 
 string TCPSegment::to_string() const
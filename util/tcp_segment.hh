@@ -1,5 +1,6 @@
 #pragma once
 
+#include "checksum.hh"
 #include "parser.hh"
 #include "ref.hh"
 #include "tcp_receiver_message.hh"
@@ -15,6 +16,12 @@ struct TCPMessage
   Ref<TCPReceiverMessage> receiver {};
 };
 
+// Explicitly copy ("clone") a message (e.g. to keep one whose sender message is borrowed)
+inline TCPMessage clone( const TCPMessage& x )
+{
+  return { TCPSenderMessage { x.sender.get() }, TCPReceiverMessage { x.receiver.get() } };
+}
+
 // A TCPSegment represents a complete (STD 7 / RFC 9293) TCP segment.
 // It includes a TCPMessage plus the UDP-like information included in the TCP header.
 struct TCPSegment
@@ -22,11 +29,20 @@ struct TCPSegment
   TCPMessage message {};
   UserDatagramInfo udinfo {};
 
-  void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum );
+  // `verify_checksum` is false when the lower layer has already vouched for the checksum (e.g. a TUN device
+  // handing over a packet with a partial checksum and VIRTIO_NET_HDR_F_NEEDS_CSUM)
+  void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum, bool verify_checksum = true );
   void serialize( Serializer& serializer ) const;
 
+  // Serialize only the header (e.g. in front of a payload that is already in place)
+  void serialize_header( Serializer& serializer ) const;
+
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
 
+  // Zero the checksum field and start the checksum with the pseudo-header and the header, so that the caller
+  // can add the payload (e.g. while copying it) and set udinfo.cksum from the result
+  InternetChecksum start_checksum( uint32_t datagram_layer_pseudo_checksum );
+
   static constexpr uint8_t HEADER_LENGTH = 20; // TCP header length, not including options
 
   // Return a string containing a summary in human-readable format
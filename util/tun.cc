@@ -14,6 +14,8 @@ using namespace std;
 //! \param[in] devname is the name of the TUN or TAP device, specified at its creation.
 //! \param[in] is_tun is `true` for a TUN device (expects IP datagrams), or `false` for a TAP device (expects
 //! Ethernet frames)
+//! \param[in] vnet_hdr is `true` to exchange a `struct virtio_net_hdr` with every packet and to enable
+//! checksum and TCPv4 segmentation offload on the device
 //!
 //! To create a TUN device, you should already have run
 //!
@@ -21,13 +23,14 @@ using namespace std;
 //!
 //! as root before calling this function.
 
-TunTapFD::TunTapFD( const string& devname, const bool is_tun )
-  : FileDescriptor( ::CheckSystemCall( "open", open( CLONEDEV, O_RDWR | O_CLOEXEC ) ) )
+TunTapFD::TunTapFD( const string& devname, const bool is_tun, const bool vnet_hdr )
+  : FileDescriptor( ::CheckSystemCall( "open", open( CLONEDEV, O_RDWR | O_CLOEXEC ) ) ), vnet_hdr_( vnet_hdr )
 {
   struct ifreq tun_req
   {};
 
-  tun_req.ifr_flags = static_cast<int16_t>( ( is_tun ? IFF_TUN : IFF_TAP ) | IFF_NO_PI ); // no packetinfo
+  tun_req.ifr_flags = static_cast<int16_t>( ( is_tun ? IFF_TUN : IFF_TAP ) | IFF_NO_PI    // no packetinfo
+                                            | ( vnet_hdr ? IFF_VNET_HDR : 0 ) ); // optional virtio-net header
 
   // copy devname to ifr_name, making sure to null terminate
 
@@ -35,4 +38,9 @@ TunTapFD::TunTapFD( const string& devname, const bool is_tun )
   tun_req.ifr_name[IFNAMSIZ - 1] = '\0';
 
   CheckSystemCall( "ioctl", ioctl( fd_num(), TUNSETIFF, static_cast<void*>( &tun_req ) ) );
+
+  if ( vnet_hdr ) {
+    // tell the kernel that we can take (and hand it) packets with partial checksums and TCPv4 super-packets
+    CheckSystemCall( "ioctl", ioctl( fd_num(), TUNSETOFFLOAD, TUN_F_CSUM | TUN_F_TSO4 ) );
+  }
 }
@@ -10,7 +10,15 @@ class TunTapFD : public FileDescriptor
 public:
   //! Open an existing persistent [TUN or TAP
   //! device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunTapFD( const std::string& devname, bool is_tun );
+  //! If `vnet_hdr` is set, every packet exchanged with the device is preceded by a `struct virtio_net_hdr`,
+  //! and the device is allowed to pass checksum-offloaded and TCPv4 GSO/GRO "super-packets" (up to 64 KiB).
+  explicit TunTapFD( const std::string& devname, bool is_tun, bool vnet_hdr = false );
+
+  //! Are packets preceded by a `struct virtio_net_hdr`?
+  bool vnet_hdr() const { return vnet_hdr_; }
+
+private:
+  bool vnet_hdr_;
 };
 
 //! A FileDescriptor to a [Linux TUN](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
@@ -18,7 +26,7 @@ class TunFD : public TunTapFD
 {
 public:
   //! Open an existing persistent [TUN device](https://www.kernel.org/doc/Documentation/networking/tuntap.txt).
-  explicit TunFD( const std::string& devname ) : TunTapFD( devname, true ) {}
+  explicit TunFD( const std::string& devname, bool vnet_hdr = false ) : TunTapFD( devname, true, vnet_hdr ) {}
 };
 
 //! A FileDescriptor to a [Linux TAP](https://www.kernel.org/doc/Documentation/networking/tuntap.txt) device
@@ -1,26 +1,107 @@
 #include "tuntap_adapter.hh"
-#include "helpers.hh"
+
+#include "exception.hh"
+
+#include <cstdint>
+#include <cstring>
+#include <poll.h>
+#include <string_view>
 
 using namespace std;
 
+namespace {
+// `struct virtio_net_hdr` from <linux/virtio_net.h> (which doesn't compile cleanly as C++), in host byte order
+struct VirtioNetHeader
+{
+  uint8_t flags;
+  uint8_t gso_type;
+  uint16_t hdr_len;     // length of the headers to copy into each segment
+  uint16_t gso_size;    // payload bytes per segment
+  uint16_t csum_start;  // where to start checksumming
+  uint16_t csum_offset; // where (after csum_start) to put the checksum
+};
+
+constexpr uint8_t VIRTIO_NET_HDR_F_NEEDS_CSUM = 1;
+constexpr uint8_t VIRTIO_NET_HDR_GSO_TCPV4 = 1;
+
+constexpr size_t VNET_HDR_LENGTH = sizeof( VirtioNetHeader );
+static_assert( VNET_HDR_LENGTH == 10 );
+
+constexpr size_t MAX_DATAGRAM_LENGTH = 65535; // largest (GRO-coalesced) IPv4 datagram
+constexpr size_t SLAB_SIZE = 16384;           // read buffer without the virtio-net header
+} // namespace
+
+TCPOverIPv4OverTunFdAdapter::TCPOverIPv4OverTunFdAdapter( TunFD&& tun )
+  : _tun( move( tun ) ), _pool( _tun.vnet_hdr() ? VNET_HDR_LENGTH + MAX_DATAGRAM_LENGTH : SLAB_SIZE )
+{}
+
 optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
 {
-  vector<string> strs( 3 );
-  strs[0].resize( IPv4Header::LENGTH );
-  strs[1].resize( TCPSegment::HEADER_LENGTH );
-  _tun.read( strs );
-
-  InternetDatagram ip_dgram;
-  if ( parse( ip_dgram, move( strs ) ) ) {
-    return unwrap_tcp_in_ip( move( ip_dgram ) );
+  // the slab goes back to the pool when this returns, so the headers are parsed where they sit in it, and only
+  // the TCP payload is copied out (in the same pass that verifies its checksum, into a string of its own size)
+  BufferPool::Slab slab = _pool.acquire();
+  string_view packet = slab.view( _tun.read( slab.span() ) );
+
+  if ( packet.empty() or ( _tun.vnet_hdr() and packet.size() < VNET_HDR_LENGTH ) ) {
+    return {}; // nothing to read (or a truncated packet)
+  }
+
+  bool verify_checksum = true;
+  if ( _tun.vnet_hdr() ) {
+    VirtioNetHeader vnet {};
+    memcpy( &vnet, packet.data(), VNET_HDR_LENGTH );
+    packet.remove_prefix( VNET_HDR_LENGTH );
+
+    // With VIRTIO_NET_HDR_F_NEEDS_CSUM, the TCP checksum field holds only the pseudo-header sum: the
+    // datagram came from the local stack, and the checksum was never computed over the segment.
+    verify_checksum = not( vnet.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM );
+  }
+
+  Parser parser { packet };
+  IPv4Header ip_header;
+  ip_header.parse( parser );
+  if ( parser.has_error() ) {
+    return {};
+  }
+  parser.truncate( ip_header.payload_length() );
+  return unwrap_tcp_in_ip( ip_header, parser, verify_checksum );
+}
+
+void TCPOverIPv4OverTunFdAdapter::_write_packet( string_view packet )
+{
+  // (a write that finds the device's queue full writes nothing: wait until there is room, and write it again)
+  while ( _tun.write( packet ) == 0 ) {
+    pollfd writable { .fd = _tun.fd_num(), .events = POLLOUT, .revents = 0 };
+    if ( ::poll( &writable, 1, -1 ) < 0 ) {
+      throw unix_error { "poll" };
+    }
   }
-  return {};
 }
 
 void TCPOverIPv4OverTunFdAdapter::write( const TCPMessage& seg )
 {
-  _tun.write( serialize( wrap_tcp_in_ip( seg ) ) );
+  // the whole packet (with the virtio-net header, if any) is built in one buffer, and written with one write()
+  PacketBuffer packet = wrap_tcp_in_packet( seg, VNET_HDR_LENGTH );
+  if ( not _tun.vnet_hdr() ) {
+    _write_packet( packet.data() );
+    return;
+  }
+
+  // The datagram carries a complete checksum, so the kernel only needs to be told about segmentation. It
+  // recomputes the checksum of every segment that it cuts from a GSO super-packet.
+  VirtioNetHeader vnet {};
+  if ( seg.sender->payload.size() > config().segment_size ) {
+    vnet.gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+    vnet.hdr_len = IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH;
+    vnet.gso_size = static_cast<uint16_t>( config().segment_size );
+  }
+
+  memcpy( packet.push( VNET_HDR_LENGTH ).data(), &vnet, VNET_HDR_LENGTH );
+  _write_packet( packet.data() );
 }
 
 //! Specialize LossyFdAdapter to TCPOverIPv4OverTunFdAdapter
 template class LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>;
+
+//! Specialize NetemFdAdapter to TCPOverIPv4OverTunFdAdapter
+template class NetemFdAdapter<TCPOverIPv4OverTunFdAdapter>;
@@ -1,11 +1,14 @@
 #pragma once
 
+#include "buffer_pool.hh"
 #include "lossy_fd_adapter.hh"
+#include "netem_fd_adapter.hh"
 #include "tcp_over_ip.hh"
 #include "tcp_segment.hh"
 #include "tun.hh"
 
 #include <optional>
+#include <string_view>
 #include <utility>
 
 template<class T>
@@ -16,14 +19,38 @@ concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
 };
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
+//! \details If the TunFD was opened with a virtio-net header (TunFD::vnet_hdr()), the adapter strips the
+//! header from incoming datagrams (skipping TCP checksum verification when the kernel marked the checksum as
+//! partial) and prepends one to outgoing datagrams. A TCP segment whose payload is longer than
+//! FdAdapterConfig::segment_size is then written as a single GSO "super-packet", which the kernel splits into
+//! segments of that size (TCPMinnowSocket::connect() sets it from the path MTU that an earlier connection
+//! found, if any). Set TCPConfig::max_payload_size to MAX_GSO_PAYLOAD_SIZE to let the TCPSender take advantage
+//! of this.
+//!
+//! Each datagram is read, with a single read(), into a slab from a BufferPool. Its headers are parsed in place,
+//! and the TCP payload is copied out once (in the same pass that verifies the checksum); the slab then goes back
+//! to the pool, so the read buffer isn't allocated (or zeroed) per datagram. The payload's copy is: a
+//! TCPSenderMessage owns its payload as a std::string, so each segment that carries data still costs one
+//! allocation of the payload's size (a segment without data, such as a pure ACK, costs none). In the other
+//! direction, each datagram (and its virtio-net header) is built in a single PacketBuffer, headers in front of
+//! the payload, and written with a single write(). The TUN device is non-blocking (see TCPMinnowSocket), so a
+//! datagram written while the device's queue is full waits in poll() until there is room, as it would in a
+//! blocking write, rather than being lost.
 class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter
 {
 private:
   TunFD _tun;
+  BufferPool _pool;
+
+  //! Write one datagram to the TUN device, waiting for room in its queue if need be
+  void _write_packet( std::string_view packet );
 
 public:
+  //! Largest TCP payload that fits in one (GSO) IPv4 datagram without options
+  static constexpr size_t MAX_GSO_PAYLOAD_SIZE = 65535 - IPv4Header::LENGTH - TCPSegment::HEADER_LENGTH;
+
   //! Construct from a TunFD
-  explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun ) : _tun( std::move( tun ) ) {}
+  explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun );
 
   //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
   std::optional<TCPMessage> read();
@@ -39,7 +66,11 @@ public:
 
   //! Access underlying file descriptor
   FileDescriptor& fd() { return _tun; }
+
+  //! Access the pool of read buffers
+  const BufferPool& pool() const { return _pool; }
 };
 
 static_assert( TCPDatagramAdapter<TCPOverIPv4OverTunFdAdapter> );
 static_assert( TCPDatagramAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>> );
+static_assert( TCPDatagramAdapter<NetemFdAdapter<TCPOverIPv4OverTunFdAdapter>> );